@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#if _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+** BitOps
+** - word wide bit scans and counts, word must not be 0 for the scans
+*/
+inline unsigned lowestBit(uint64_t word)
+{
+#if _MSC_VER
+	unsigned long bit;
+	_BitScanForward64(&bit, word);
+	return bit;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+inline unsigned highestBit(uint64_t word)
+{
+#if _MSC_VER
+	unsigned long bit;
+	_BitScanReverse64(&bit, word);
+	return bit;
+#else
+	return 63 - __builtin_clzll(word);
+#endif
+}
+
+inline unsigned popCount(uint64_t word)
+{
+#if _MSC_VER
+	return static_cast<unsigned>(__popcnt64(word));
+#else
+	return __builtin_popcountll(word);
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+/*
+** Checkpoint
+** - fixed width binary records written to and read back from a file
+** - the writer and reader remember the first failure so callers check once at the end
+*/
+class CheckpointWriter
+{
+protected:
+	FILE *_file;
+	bool _ok;
+public:
+	CheckpointWriter(FILE *file) : _file(file), _ok(file != 0) {}
+	bool ok() const { return _ok; }
+
+	void write(const void *data, size_t size) { if (_ok && size) _ok = fwrite(data, size, 1, _file) == 1; }
+	template <typename Type> void write(const Type &value) { write(&value, sizeof(Type)); }
+	void write(const std::string &value)
+	{
+		write(static_cast<uint32_t>(value.size()));
+		write(value.data(), value.size());
+	}
+};
+
+class CheckpointReader
+{
+protected:
+	FILE *_file;
+	bool _ok;
+public:
+	CheckpointReader(FILE *file) : _file(file), _ok(file != 0) {}
+	bool ok() const { return _ok; }
+
+	bool read(void *data, size_t size) { if (_ok && size) _ok = fread(data, size, 1, _file) == 1; return _ok; }
+	template <typename Type> bool read(Type &value) { return read(&value, sizeof(Type)); }
+	bool read(std::string &value)
+	{
+		uint32_t size(0);
+		if (!read(size)) return false;
+		value.resize(size);
+		return read(&value[0], size);
+	}
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+struct DepthSum
+{
+	uint64_t _shares;
+	uint64_t _notional;
+};
+
+/*
+** CumulativeDepth
+** - binary indexed tree of shares and notional by depth index, index 0 is the inside of the book
+** - prefix sums and the index where a sweep of n shares completes in O(log n)
+** - decreases are added as wrapped unsigned values, the sums stay exact
+*/
+class CumulativeDepth
+{
+protected:
+	// one based tree
+	DepthSum *_tree;
+	DepthSum _total;
+	unsigned _size;
+	unsigned _topBit;
+public:
+	CumulativeDepth(): _tree(0), _size(0), _topBit(0) { _total._shares = _total._notional = 0; }
+	void initialize(unsigned size);
+	void clear();
+	unsigned size() const { return _size; }
+
+	void add(unsigned index, uint64_t shares, uint64_t notional);
+	// sum over indexes [0, cnt)
+	DepthSum sum(unsigned cnt) const;
+	const DepthSum &total() const { return _total; }
+	// number of leading indexes holding less than shares and their sum
+	unsigned lowerBound(uint64_t shares, DepthSum &before) const;
+
+	~CumulativeDepth() { delete[] _tree; }
+private:
+	CumulativeDepth(const CumulativeDepth&) = delete;
+	CumulativeDepth& operator = (const CumulativeDepth&) = delete;
+};
+
+inline
+void CumulativeDepth::initialize(unsigned size)
+{
+	delete[] _tree;
+	_size = size;
+	_tree = _size ? new DepthSum[_size + 1]() : 0;
+	_total._shares = _total._notional = 0;
+	for (_topBit = 1; _topBit <= _size; _topBit <<= 1);
+	_topBit >>= 1;
+}
+
+inline
+void CumulativeDepth::clear()
+{
+	if (_tree) memset(_tree, 0, (_size + 1) * sizeof(DepthSum));
+	_total._shares = _total._notional = 0;
+}
+
+inline
+void CumulativeDepth::add(unsigned index, uint64_t shares, uint64_t notional)
+{
+	_total._shares += shares;
+	_total._notional += notional;
+	for (unsigned node = index + 1; node <= _size; node += node & (0 - node))
+	{
+		_tree[node]._shares += shares;
+		_tree[node]._notional += notional;
+	}
+}
+
+inline
+DepthSum CumulativeDepth::sum(unsigned cnt) const
+{
+	DepthSum depthSum = { 0, 0 };
+	if (cnt > _size) cnt = _size;
+	for (unsigned node = cnt; node; node &= node - 1)
+	{
+		depthSum._shares += _tree[node]._shares;
+		depthSum._notional += _tree[node]._notional;
+	}
+	return depthSum;
+}
+
+inline
+unsigned CumulativeDepth::lowerBound(uint64_t shares, DepthSum &before) const
+{
+	before._shares = before._notional = 0;
+	unsigned cnt(0);
+	for (unsigned bit = _topBit; bit; bit >>= 1)
+	{
+		unsigned node = cnt + bit;
+		if (node <= _size && before._shares + _tree[node]._shares < shares)
+		{
+			cnt = node;
+			before._shares += _tree[node]._shares;
+			before._notional += _tree[node]._notional;
+		}
+	}
+	return cnt;
+}
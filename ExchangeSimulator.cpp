@@ -12,51 +12,138 @@
 
 #include "Order.h"
 
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+#if _MSC_VER
+#include <xmmintrin.h>
+#endif
+
 namespace
 {
 // TODO: move to a common time file
-timespec addTime(const timespec &ts, uint64_t nanoseconds)
+uint64_t timespecToNanoseconds(const timespec &ts)
 {
-	timespec time(ts);
-	uint64_t totalNanoseconds = time.tv_nsec + nanoseconds;
-	time.tv_sec += totalNanoseconds / 1000000000;
-	time.tv_nsec = totalNanoseconds % 1000000000;
-	return time;
+	return (ts.tv_sec % 604800) * 1000000000 + ts.tv_nsec;
 }
 
-uint64_t timespecToNanoseconds(const timespec &ts)
+uint64_t nanoseconds(const timespec &ts)
 {
-	return (ts.tv_sec % 604800) * 1000000000 + ts.tv_nsec;
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
 }
 
-bool less(const timespec &l, const timespec &r)
+timespec toTimespec(uint64_t nanoseconds)
 {
-	return l.tv_sec < r.tv_sec || (l.tv_sec == r.tv_sec && l.tv_nsec < r.tv_nsec);
+	timespec ts;
+	ts.tv_sec = nanoseconds / 1000000000;
+	ts.tv_nsec = nanoseconds % 1000000000;
+	return ts;
 }
 
-char *StrCpy(char *output, const char *input, size_t outputSize)
+// "XSCK"
+const uint32_t CheckpointMagic = 0x4b435358;
+const uint32_t CheckpointVersion = 1;
+
+struct CheckpointOrder
 {
-	char *o = output - 1;
-	if (input)
+	enum
 	{
-		const char *end = input + outputSize - 2;
-		for (char c = *input; c && input < end; c = *++input)
-			*++o = c;
-	}
-	*++o = 0;
-	return output;
+		Quote = 0,
+		Market = 1,
+		Simulated = 2
+	};
+};
+
+inline void prefetch(const void *address)
+{
+#if _MSC_VER
+	_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+	__builtin_prefetch(address);
+#endif
+}
+
+// transact time and clOrdId order, orders of different threads reusing both are ordered by what they ask for,
+// orders equal in every key give the same reports whichever of them goes first
+bool queuedBefore(const Order *l, const Order *r)
+{
+	uint64_t lTime = nanoseconds(l->transactTime()), rTime = nanoseconds(r->transactTime());
+	if (lTime != rTime) return lTime < rTime;
+	if (l->clOrdId() != r->clOrdId()) return l->clOrdId() < r->clOrdId();
+	if (l->symbolId() != r->symbolId()) return l->symbolId() < r->symbolId();
+	if (l->msgType() != r->msgType()) return l->msgType() < r->msgType();
+	if (l->sideId() != r->sideId()) return l->sideId() < r->sideId();
+	if (l->price() != r->price()) return l->price() < r->price();
+	if (l->orderQty() != r->orderQty()) return l->orderQty() < r->orderQty();
+	// new orders have no original
+	return l->msgType() != FIX::MsgType::NewOrder && l->origClOrdId() < r->origClOrdId();
 }
 } // namespace
 
+const char *SimulatorExecutionReport::text()
+{
+	if (*_text || _rejectReason == RejectReason::None) return _text;
+	switch (_rejectReason)
+	{
+	case RejectReason::DuplicateClOrdId:
+		snprintf(_text, sizeof(_text), "clOrdId %llu: not unique", static_cast<unsigned long long>(_rejectArg));
+		break;
+	case RejectReason::UnknownOrigClOrdId:
+		snprintf(_text, sizeof(_text), "origClOrdId %llu unknown", static_cast<unsigned long long>(_rejectArg));
+		break;
+	case RejectReason::UnhandledMsgType:
+		strcpy(_text, "unhandled MsgType");
+		break;
+	default:
+		snprintf(_text, sizeof(_text), "reject reason %d", _rejectReason);
+		break;
+	}
+	return _text;
+}
+
+SimulatorExecutionReport &ExchangeSimulator::executionReport(SimulatorExecutionReport &localReport)
+{
+	// queued reports are built in their slot
+	if (!_executionReportQueue) return localReport;
+	SimulatorExecutionReport *executionReport;
+	while (!(executionReport = _executionReportQueue->back()))
+	{
+		// waiting would never return if the consumer drains on this thread, the report is built in localReport and dropped
+		if (!_waitForReportQueue)
+		{
+			if (!_droppedReportCnt++)
+				printf("%s %s %d: ERROR: execution report queue full, dropping reports\n", __FILE__, __FUNCTION__, __LINE__);
+			return localReport;
+		}
+		std::this_thread::yield();
+	}
+	return *executionReport;
+}
+
+void ExchangeSimulator::deliver(SimulatorExecutionReport &executionReport, const SimulatorExecutionReport &localReport)
+{
+	StageTimer stageTimer(_stats, SimulatorStats::Stage::Report);
+	if (_executionReportQueue)
+	{
+		if (&executionReport != &localReport) _executionReportQueue->push_back();
+	}
+	else if (_executionReportCallback) _executionReportCallback->onExecution(executionReport);
+}
+
 void ExchangeSimulator::execute(int side, unsigned price, unsigned shares, BookOrder *bookOrder)
 {
+	_stats.count(SimulatorStats::Counter::Executions);
 	bookOrder->_shares -= shares;
 	Order *order;
 	if ((order = bookOrder->_order))
 	{
-		ExecutionReport executionReport;
+		SimulatorExecutionReport localReport;
+		SimulatorExecutionReport &executionReport = this->executionReport(localReport);
 		executionReport._clOrdId = order->clOrdId();
-		StrCpy(executionReport._symbol, order->symbol(), sizeof(executionReport._symbol));
+		executionReport._symbolId = order->symbolId();
+		*executionReport._symbol = 0;
 		executionReport._lastPx = price;
 		executionReport._lastQty = shares;
 		executionReport._side = order->side();
@@ -72,93 +159,243 @@ void ExchangeSimulator::execute(int side, unsigned price, unsigned shares, BookO
 		}
 		executionReport._transactTime = timespecToNanoseconds(_timeManager->time());
 		*executionReport._text = 0;
+		executionReport._rejectReason = RejectReason::None;
 
-		if (_executionReportCallback) _executionReportCallback->onExecution(executionReport);
+		deliver(executionReport, localReport);
 	}
-	else
+	else if (!bookOrder->_orderId)
 	{
 		printf("%s %s %d: Warning: quote executed\n", __FILE__, __FUNCTION__, __LINE__);
 	}
 }
 
-void ExchangeSimulator::status(char execType, char ordStatus, const char * text, Order * order)
+void ExchangeSimulator::status(char execType, char ordStatus, Order *order, int rejectReason, uint64_t rejectArg)
 {
-	ExecutionReport executionReport;
+	SimulatorExecutionReport localReport;
+	SimulatorExecutionReport &executionReport = this->executionReport(localReport);
 	executionReport._clOrdId = order->clOrdId();
-	StrCpy(executionReport._symbol, order->symbol(),sizeof(executionReport._symbol));
+	executionReport._symbolId = order->symbolId();
+	*executionReport._symbol = 0;
 	executionReport._lastPx = 0;
 	executionReport._lastQty = 0;
 	executionReport._side = order->side();
 	executionReport._execType = execType;
 	executionReport._ordStatus = ordStatus;
 	executionReport._transactTime = timespecToNanoseconds(_timeManager->time());
-	StrCpy(executionReport._text, text, sizeof(executionReport._text));
+	*executionReport._text = 0;
+	executionReport._rejectReason = rejectReason;
+	executionReport._rejectArg = rejectArg;
 
-	if (_executionReportCallback) _executionReportCallback->onExecution(executionReport);
+	deliver(executionReport, localReport);
 }
 
-ExchangeSimulator::ExchangeSimulator(uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, TimeManager * timeManager):
+void ExchangeSimulator::reject(Order *order, int rejectReason, uint64_t rejectArg)
+{
+	status(FIX::ExecType::Rejected, FIX::OrdStatus::Rejected, order, rejectReason, rejectArg);
+}
+
+ExchangeSimulator::ExchangeSimulator(uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, TimeManager * timeManager, SymbolRegistry *symbolRegistry):
 	_delayNanoseconds(delayMicroseconds * 1000),
-	_orderBookTable(bookCnt, OrderBookEqual()),
+	_latencyModel(0),
+	_timeEventPending(false),
 	_bookOrderTable(orderCnt, BookOrderEqual()),
+	_marketOrderTable(0),
+	_marketOrderCnt(1 << 20),
+	_symbolRegistry(symbolRegistry),
+	_orderBookPool(bookCnt ? bookCnt : 1),
 	_executionReportCallback(0),
-	_timeManager(timeManager)
+	_executionReportQueue(0),
+	_waitForReportQueue(false),
+	_droppedReportCnt(0),
+	_timeManager(timeManager),
+	_orderQueue(0),
+	_depthCallback(0),
+	_ladderSize(0),
+	_ladderTickSize(1),
+	_lazyTopOfBook(false),
+	_tradeFillRule(TradeFillRule::QueuePosition),
+	_checkpointCallback(0),
+	_checkpointTime(0),
+	_checkpointInterval(0)
 {
+	_arenaSize._priceLevelCnt = _arenaSize._bookOrderCnt = 0;
+	_orderBooks.reserve(bookCnt);
 }
 
-void ExchangeSimulator::onOrder(Order *order)
+ExchangeSimulator::~ExchangeSimulator()
 {
-	BookOrder *bookOrder = _bookOrderAllocator.allocate();
-	bookOrder->initialize(order->clOrdId(), order->orderQty(), order, addTime(order->transactTime(), _delayNanoseconds));
-	if (_pendingOrderList.empty())
+	delete _marketOrderTable;
+}
+
+void ExchangeSimulator::setBookArena(size_t priceLevelCnt, size_t bookOrderCnt)
+{
+	_arenaSize._priceLevelCnt = priceLevelCnt;
+	_arenaSize._bookOrderCnt = bookOrderCnt;
+}
+
+void ExchangeSimulator::setBookArenaHint(SymbolId symbolId, size_t priceLevelCnt, size_t bookOrderCnt)
+{
+	ArenaSize &arenaSize = _arenaSizeHints[symbolId];
+	arenaSize._priceLevelCnt = priceLevelCnt;
+	arenaSize._bookOrderCnt = bookOrderCnt;
+}
+
+OrderBook *ExchangeSimulator::createOrderBook(SymbolId symbolId)
+{
+	OrderBook *orderBook = _orderBookPool.allocate();
+	orderBook->initialize(this, symbolId);
+	if (_arenaSize._priceLevelCnt && _arenaSize._bookOrderCnt)
 	{
-		_timespec = bookOrder->_receivedTime;
+		std::unordered_map<SymbolId, ArenaSize>::const_iterator itr = _arenaSizeHints.find(symbolId);
+		const ArenaSize &arenaSize = itr != _arenaSizeHints.end() ? itr->second : _arenaSize;
+		orderBook->setArena(arenaSize._priceLevelCnt, arenaSize._bookOrderCnt);
+	}
+	else orderBook->setAllocators(&_priceLevelAllocator, &_bookOrderAllocator);
+	if (_ladderSize) orderBook->setPriceLadder(_ladderSize, _ladderTickSize);
+	orderBook->setDepthTracking(_depthCallback != 0);
+	if (_lazyTopOfBook) orderBook->setTopOfBookOnly();
+	if (!(symbolId < _orderBooks.size())) _orderBooks.resize(symbolId + 1);
+	_orderBooks[symbolId] = orderBook;
+	return orderBook;
+}
+
+void ExchangeSimulator::createOrderBooks(unsigned shardIdx, unsigned shardCnt)
+{
+	if (!shardCnt) shardCnt = 1;
+	SymbolId symbolCnt = static_cast<SymbolId>(_symbolRegistry->size());
+	size_t bookCnt(0);
+	for (SymbolId symbolId = shardIdx; symbolId < symbolCnt; symbolId += shardCnt)
+		if (!findOrderBook(symbolId)) ++bookCnt;
+
+	// one block for the universe, the book index and the depth batch sized to match
+	_orderBookPool.reserve(bookCnt);
+	if (_orderBooks.size() < symbolCnt) _orderBooks.resize(symbolCnt);
+	if (_depthCallback) _depthChangedBooks.reserve(_orderBookPool.capacity());
+	if (!(_arenaSize._priceLevelCnt && _arenaSize._bookOrderCnt))
+	{
+		_priceLevelAllocator.reserve(_priceLevelAllocator.blockSize());
+		_bookOrderAllocator.reserve(_bookOrderAllocator.blockSize());
+	}
+	for (SymbolId symbolId = shardIdx; symbolId < symbolCnt; symbolId += shardCnt)
+		if (!findOrderBook(symbolId)) createOrderBook(symbolId)->reserve();
+}
+
+OrderBook *ExchangeSimulator::orderBook(SymbolId symbolId)
+{
+	OrderBook *orderBook = findOrderBook(symbolId);
+	return orderBook ? orderBook : createOrderBook(symbolId);
+}
+
+void ExchangeSimulator::checkTopOfBookOnly(OrderBook *orderBook)
+{
+	if (_lazyTopOfBook && !orderBook->topOfBookOnly() && orderBook->quoteOnly()) orderBook->setTopOfBookOnly();
+}
+
+void ExchangeSimulator::reportMemory(BookMemoryCallback *callback)
+{
+	BookMemory total = {};
+	size_t bookCnt(0);
+	for (OrderBook *orderBook : _orderBooks)
+	{
+		if (!orderBook) continue;
+		++bookCnt;
+		BookMemory bookMemory;
+		orderBook->memory(bookMemory);
+		if (callback) callback->onBookMemory(*orderBook, bookMemory);
+		else printf("%s bytes %zu blocks %zu levels %zu/%zu orders %zu/%zu fragmentation %.2f\n", _symbolRegistry->symbol(orderBook->symbolId()), bookMemory._bytes, bookMemory._blockCnt,
+			bookMemory._priceLevelCnt, bookMemory._priceLevelCapacity, bookMemory._bookOrderCnt, bookMemory._bookOrderCapacity, bookMemory.fragmentation());
+		total._bytes += bookMemory._bytes;
+		total._blockCnt += bookMemory._blockCnt;
+		total._priceLevelCnt += bookMemory._priceLevelCnt;
+		total._priceLevelCapacity += bookMemory._priceLevelCapacity;
+		total._bookOrderCnt += bookMemory._bookOrderCnt;
+		total._bookOrderCapacity += bookMemory._bookOrderCapacity;
+	}
+	if (!callback) printf("books %zu bytes %zu blocks %zu fragmentation %.2f\n", bookCnt, total._bytes, total._blockCnt, total.fragmentation());
+}
+
+void ExchangeSimulator::publishDepth()
+{
+	for (OrderBook *orderBook : _depthChangedBooks)
+		orderBook->publishDepth(_depthCallback);
+	_depthChangedBooks.clear();
+}
+
+void ExchangeSimulator::scheduleTimeEvent(uint64_t time)
+{
+	// wake only for the earliest pending order
+	if (_timeEventPending)
+	{
+		if (time < nanoseconds(_timespec))
+		{
+			_timespec = toTimespec(time);
+			_timeManager->reprioritize(this);
+		}
+	}
+	else
+	{
+		_timespec = toTimespec(time);
 		_timeManager->addCallback(this);
+		_timeEventPending = true;
 	}
-	_pendingOrderList.push_back(bookOrder);
+}
+
+void ExchangeSimulator::onOrder(Order *order)
+{
+	BookOrder *bookOrder = orderBook(order->symbolId())->allocateBookOrder();
+	uint64_t latency = _latencyModel ? _latencyModel->latency(*order) : _delayNanoseconds;
+	uint64_t receivedTime = nanoseconds(order->transactTime()) + latency;
+	bookOrder->initialize(order->clOrdId(), order->orderQty(), order, toTimespec(receivedTime));
+	_pendingOrders.insert(bookOrder);
+	scheduleTimeEvent(receivedTime);
+}
+
+void ExchangeSimulator::drainOrders()
+{
+	_orderQueue->drain([this](Order *order) { _queuedOrders.push_back(order); });
+	if (_queuedOrders.empty()) return;
+
+	// the queue holds the orders in the order the threads got to it, sort them so latency draws and ties do not depend on it
+	std::sort(_queuedOrders.begin(), _queuedOrders.end(), queuedBefore);
+	for (Order *order : _queuedOrders)
+		onOrder(order);
+	_queuedOrders.clear();
 }
 
 void ExchangeSimulator::timeEvent(const timespec &ts)
 {
-	for (Intrusive::LinkedListObject *obj = _pendingOrderList.begin(); obj != _pendingOrderList.end(); obj = _pendingOrderList.begin())
+	_timeEventPending = false;
+	Intrusive::LinkedList arrivedOrders;
+	_pendingOrders.expire(nanoseconds(ts), arrivedOrders);
+	for (Intrusive::LinkedListObject *obj = arrivedOrders.begin(); obj != arrivedOrders.end(); obj = arrivedOrders.begin())
 	{
+		StageTimer stageTimer(_stats, SimulatorStats::Stage::TimeEvent);
 		BookOrder *bookOrder = static_cast<BookOrder*>(obj);
-		if (less(ts, bookOrder->_receivedTime))
-		{
-			_timespec = bookOrder->_receivedTime;
-			_timeManager->addCallback(this);
-			break;
-		}
 		bookOrder->unlink();
 		Order *order = bookOrder->_order;
 
-		const char *symbol(order->symbol());
-		OrderBook *orderBook(0);
+		// the book the order was allocated from
+		OrderBook *orderBook(findOrderBook(order->symbolId()));
 
 		switch (order->msgType())
 		{
 			case FIX::MsgType::NewOrder:
 			{
-				if (!(orderBook = _orderBookTable.find(symbol)))
-				{
-					orderBook = new OrderBook(this, symbol);
-					_orderBookTable.insert(symbol, orderBook);
-				}
+				if (orderBook->topOfBookOnly()) orderBook->promote();
 
 				// add order to book
-				if (_bookOrderTable.insert(order->clOrdId(), bookOrder))
+				if (!_bookOrderTable.insert(order->clOrdId(), bookOrder))
 				{
-					// reject
-					char text[32];
-					snprintf(text, sizeof(text), "clOrdId %I64u: not unique", order->clOrdId());
-					status(FIX::ExecType::Rejected, FIX::OrdStatus::Rejected, text, order);
+					reject(order, RejectReason::DuplicateClOrdId, order->clOrdId());
+					orderBook->freeBookOrder(bookOrder);
 					break;
 				}
 
 				if (!orderBook->newOrder(FIX::Side::sideId(order->side()), order->price(), bookOrder))
 				{
-					status(FIX::ExecType::New, FIX::OrdStatus::New, "", order);
+					status(FIX::ExecType::New, FIX::OrdStatus::New, order);
 				}
+				else orderBook->freeBookOrder(bookOrder);
 				break;
 			}
 			case FIX::MsgType::CancelRequest:
@@ -166,15 +403,15 @@ void ExchangeSimulator::timeEvent(const timespec &ts)
 				BookOrder *originalBookOrder;
 				if (!(originalBookOrder = _bookOrderTable.find(order->origClOrdId())))
 				{
-					// reject
-					char text[32];
-					snprintf(text, sizeof(text), "origClOrdId %I64u unknown", order->origClOrdId());
-					status(FIX::ExecType::Rejected, FIX::OrdStatus::Rejected, text, order);
+					reject(order, RejectReason::UnknownOrigClOrdId, order->origClOrdId());
+					orderBook->freeBookOrder(bookOrder);
 					break;
 				}
 				originalBookOrder->removeFromHash();
 				OrderBook *originalOrderBook = originalBookOrder->_priceLevel->orderBook();
 				originalOrderBook->cancelRequest(FIX::Side::sideId(order->side()), originalBookOrder);
+				originalOrderBook->freeBookOrder(originalBookOrder);
+				orderBook->freeBookOrder(bookOrder);
 				break;
 			}
 			case FIX::MsgType::ReplaceRequest:
@@ -182,19 +419,16 @@ void ExchangeSimulator::timeEvent(const timespec &ts)
 				BookOrder *originalBookOrder;
 				if (!(originalBookOrder = _bookOrderTable.find(order->origClOrdId())))
 				{
-					char text[32];
-					snprintf(text, sizeof(text), "origClOrdId %I64u unknown", order->origClOrdId());
-					status(FIX::ExecType::Rejected, FIX::OrdStatus::Rejected, text, order);
+					reject(order, RejectReason::UnknownOrigClOrdId, order->origClOrdId());
+					orderBook->freeBookOrder(bookOrder);
 					break;
 				}
 
 				// add to orderbook
-				if (_bookOrderTable.insert(order->clOrdId(), bookOrder))
+				if (!_bookOrderTable.insert(order->clOrdId(), bookOrder))
 				{
-					// reject
-					char text[32];
-					snprintf(text, sizeof(text), "clOrdId %I64u: not unique", order->clOrdId());
-					status(FIX::ExecType::Rejected, FIX::OrdStatus::Rejected, text, order);
+					reject(order, RejectReason::DuplicateClOrdId, order->clOrdId());
+					orderBook->freeBookOrder(bookOrder);
 					break;
 				}
 
@@ -202,8 +436,10 @@ void ExchangeSimulator::timeEvent(const timespec &ts)
 				OrderBook *originalOrderBook = originalBookOrder->_priceLevel->orderBook();
 				if (!originalOrderBook->replaceRequest(order->sideId(), order->price(), bookOrder, originalBookOrder))
 				{
-					status(FIX::ExecType::Replaced, FIX::OrdStatus::Replaced, "", order);
+					status(FIX::ExecType::Replaced, FIX::OrdStatus::Replaced, order);
 				}
+				else orderBook->freeBookOrder(bookOrder);
+				originalOrderBook->freeBookOrder(originalBookOrder);
 				break;
 			}
 			case FIX::MsgType::StatusRequest:
@@ -211,44 +447,58 @@ void ExchangeSimulator::timeEvent(const timespec &ts)
 				BookOrder *originalBookOrder;
 				if (!(originalBookOrder = _bookOrderTable.find(order->origClOrdId())))
 				{
-					char text[32];
-					snprintf(text, sizeof(text), "origClOrdId %I64u unknown", order->origClOrdId());
-					status(FIX::ExecType::Rejected, FIX::OrdStatus::Rejected, text, order);
+					reject(order, RejectReason::UnknownOrigClOrdId, order->origClOrdId());
+					orderBook->freeBookOrder(bookOrder);
 					break;
 				}
-				if(originalBookOrder->_shares == order->orderQty()) status(FIX::ExecType::New, FIX::OrdStatus::New, "", order);
-				else status(FIX::ExecType::Trade, FIX::OrdStatus::PartiallyFilled, "", order);
+				if(originalBookOrder->_shares == order->orderQty()) status(FIX::ExecType::New, FIX::OrdStatus::New, order);
+				else status(FIX::ExecType::Trade, FIX::OrdStatus::PartiallyFilled, order);
+				orderBook->freeBookOrder(bookOrder);
 				break;
 			}
 			default:
 			{
-				status(FIX::ExecType::Rejected, FIX::OrdStatus::Rejected, "unhandled MsgType", order);
+				reject(order, RejectReason::UnhandledMsgType, order->msgType());
+				orderBook->freeBookOrder(bookOrder);
 				break;
 			}
 		}
+		checkTopOfBookOnly(orderBook);
 	}
+	if (!_pendingOrders.empty()) scheduleTimeEvent(_pendingOrders.nextTime());
+
+	if (!_depthChangedBooks.empty()) publishDepth();
 }
 
 void ExchangeSimulator::onQuote(const Quote & quote)
 {
+	StageTimer stageTimer(_stats, SimulatorStats::Stage::OnQuote);
 	if (quote._price[0] < quote._price[1])
 	{
-		BookOrder *bidOrder = _bookOrderAllocator.allocate();
-		BookOrder *askOrder = _bookOrderAllocator.allocate();
+		OrderBook *orderBook = findOrderBook(quote._symbolId);
+		bool created = !orderBook;
+		if (created) orderBook = createOrderBook(quote._symbolId);
+		if (orderBook->topOfBookOnly())
+		{
+			orderBook->setQuote(quote._price, quote._size, quote._ts);
+			return;
+		}
+
+		BookOrder *bidOrder = orderBook->allocateBookOrder();
+		BookOrder *askOrder = orderBook->allocateBookOrder();
 		bidOrder->initialize(0, quote._size[0], quote._ts);
 		askOrder->initialize(0, quote._size[1], quote._ts);
-		OrderBook *orderBook;
-		if (!(orderBook = _orderBookTable.find(quote._symbol)))
+		// books created by an order or promoted before their first quote have no quote orders yet
+		if (!orderBook->_quoteOrders[0])
 		{
-			orderBook = new OrderBook(this, quote._symbol);
-			_orderBookTable.insert(orderBook->symbol(), orderBook);
 			orderBook->newOrder(0, quote._price[0], bidOrder);
 			orderBook->newOrder(1, quote._price[1], askOrder);
 		}
 		else
 		{
 			BookOrder *oldBid(orderBook->_quoteOrders[0]), *oldAsk(orderBook->_quoteOrders[1]);
-			if (quote._price[0] < oldAsk->_priceLevel->price())
+			// an old ask simulated orders took completely is out of the book and cannot cross the new bid
+			if (!oldAsk->_priceLevel || quote._price[0] < oldAsk->_priceLevel->price())
 			{
 				orderBook->replaceRequest(0, quote._price[0], bidOrder, oldBid);
 				orderBook->replaceRequest(1, quote._price[1], askOrder, oldAsk);
@@ -258,26 +508,78 @@ void ExchangeSimulator::onQuote(const Quote & quote)
 				orderBook->replaceRequest(1, quote._price[1], askOrder, oldAsk);
 				orderBook->replaceRequest(0, quote._price[0], bidOrder, oldBid);
 			}
-			_bookOrderAllocator.free(oldBid);
-			_bookOrderAllocator.free(oldAsk);
+			orderBook->freeBookOrder(oldBid);
+			orderBook->freeBookOrder(oldAsk);
 		}
 		orderBook->_quoteOrders[0] = bidOrder;
 		orderBook->_quoteOrders[1] = askOrder;
+		// the quote may have filled the last simulated orders
+		if (!created) checkTopOfBookOnly(orderBook);
 	}
 	else
 	{
-		printf("%s %s %d: ERROR: %s quote crossed bid %u ask %u\n", __FILE__, __FUNCTION__, __LINE__, quote._symbol, quote._price[0], quote._price[1]);
+		printf("%s %s %d: ERROR: %s quote crossed bid %u ask %u\n", __FILE__, __FUNCTION__, __LINE__, _symbolRegistry->symbol(quote._symbolId), quote._price[0], quote._price[1]);
 	}
 }
 
 void ExchangeSimulator::onTrade(const Trade &trade)
 {
+	// top of book only books hold no simulated orders
+	OrderBook *orderBook = findOrderBook(trade._symbolId);
+	if (!orderBook || orderBook->topOfBookOnly()) return;
+	orderBook->trade(trade._price, trade._size, _tradeFillRule);
+	checkTopOfBookOnly(orderBook);
+}
 
+void ExchangeSimulator::onMarketOrder(const MarketOrder &marketOrder)
+{
+	if (!_marketOrderTable) _marketOrderTable = new MarketOrderTable(_marketOrderCnt);
+	if (marketOrder._action == MarketOrder::Add)
+	{
+		OrderBook *orderBook = this->orderBook(marketOrder._symbolId);
+		if (orderBook->topOfBookOnly()) orderBook->promote();
+		BookOrder *bookOrder = orderBook->allocateBookOrder();
+		bookOrder->initialize(marketOrder._orderId, marketOrder._size, marketOrder._ts);
+		bookOrder->_symbolId = marketOrder._symbolId;
+		if (!marketOrder._orderId || !_marketOrderTable->insert(marketOrder._orderId, bookOrder))
+		{
+			printf("%s %s %d: ERROR: %s market order %llu not unique\n", __FILE__, __FUNCTION__, __LINE__, _symbolRegistry->symbol(marketOrder._symbolId), static_cast<unsigned long long>(marketOrder._orderId));
+			orderBook->freeBookOrder(bookOrder);
+			return;
+		}
+		orderBook->newOrder(marketOrder._side, marketOrder._price, bookOrder);
+		return;
+	}
+
+	BookOrder *bookOrder = _marketOrderTable->find(marketOrder._orderId);
+	OrderBook *orderBook = findOrderBook(marketOrder._symbolId);
+	if (!bookOrder || !orderBook)
+	{
+		printf("%s %s %d: ERROR: %s market order %llu unknown\n", __FILE__, __FUNCTION__, __LINE__, _symbolRegistry->symbol(marketOrder._symbolId), static_cast<unsigned long long>(marketOrder._orderId));
+		return;
+	}
+	switch (marketOrder._action)
+	{
+	case MarketOrder::Modify:
+		orderBook->modifyMarketOrder(marketOrder._side, marketOrder._price, marketOrder._size, bookOrder);
+		if (bookOrder->_marketShares) return;
+		break;
+	case MarketOrder::Execute:
+		if (!orderBook->executeMarketOrder(bookOrder, marketOrder._size)) return;
+		break;
+	case MarketOrder::Delete:
+		orderBook->deleteMarketOrder(bookOrder);
+		break;
+	default:
+		printf("%s %s %d: unhandled market order action: %d\n", __FILE__, __FUNCTION__, __LINE__, marketOrder._action);
+		return;
+	}
+	bookOrder->removeFromHash();
+	orderBook->freeBookOrder(bookOrder);
 }
 
-void ExchangeSimulator::onTick(const Tick &tick)
+void ExchangeSimulator::dispatch(const Tick &tick)
 {
-	_timeManager->setTime(tick._ts);
 	switch (tick._type)
 	{
 	case Tick::Quote:
@@ -290,8 +592,351 @@ void ExchangeSimulator::onTick(const Tick &tick)
 		onTrade(static_cast<const Trade&>(tick));
 		break;
 	}
+	case Tick::MarketOrder:
+	{
+		onMarketOrder(static_cast<const MarketOrder&>(tick));
+		break;
+	}
 	default:
 		printf("%s %s %d: unhandled tick type: %d\n", __FILE__, __FUNCTION__, __LINE__, tick._type);
 		break;
 	}
 }
+
+void ExchangeSimulator::onTick(const Tick &tick)
+{
+	StageTimer stageTimer(_stats, SimulatorStats::Stage::OnTick);
+	if (_orderQueue) drainOrders();
+	if (_checkpointCallback && nanoseconds(tick._ts) >= _checkpointTime) checkpointDue(tick._ts);
+	_timeManager->setTime(tick._ts);
+	dispatch(tick);
+	if (!_depthChangedBooks.empty()) publishDepth();
+}
+
+void ExchangeSimulator::onTicks(const Tick *const *ticks, size_t tickCnt)
+{
+	// ticks keep their order, grouping symbols would reorder the execution reports
+	uint64_t lastTime = 0;
+	for (size_t idx = 0; idx < tickCnt; ++idx)
+	{
+		StageTimer stageTimer(_stats, SimulatorStats::Stage::OnTick);
+		const Tick &tick = *ticks[idx];
+		if (idx + 1 < tickCnt)
+		{
+			OrderBook *nextOrderBook = findOrderBook(ticks[idx + 1]->_symbolId);
+			if (nextOrderBook) prefetch(nextOrderBook);
+		}
+
+		if (_orderQueue) drainOrders();
+		if (_checkpointCallback && nanoseconds(tick._ts) >= _checkpointTime) checkpointDue(tick._ts);
+		// time moves once per timestamp unless something scheduled since, such as an order from a report callback, is due now
+		uint64_t time = nanoseconds(tick._ts);
+		if (!idx || time != lastTime || time >= _timeManager->nextTime()) _timeManager->setTime(tick._ts);
+		lastTime = time;
+		dispatch(tick);
+		if (!_depthChangedBooks.empty()) publishDepth();
+	}
+}
+
+void ExchangeSimulator::setCheckpoint(CheckpointCallback *callback, const timespec &ts, uint64_t intervalNanoseconds)
+{
+	_checkpointCallback = callback;
+	_checkpointTime = nanoseconds(ts);
+	_checkpointInterval = intervalNanoseconds;
+}
+
+void ExchangeSimulator::checkpointDue(const timespec &ts)
+{
+	CheckpointCallback *callback = _checkpointCallback;
+	timespec checkpointTime = toTimespec(_checkpointTime);
+	// one call per tick even when the tick skips several intervals
+	if (_checkpointInterval) _checkpointTime += ((nanoseconds(ts) - _checkpointTime) / _checkpointInterval + 1) * _checkpointInterval;
+	else _checkpointCallback = 0;
+	callback->onCheckpoint(*this, checkpointTime);
+}
+
+void ExchangeSimulator::checkpointBook(CheckpointWriter &writer, OrderBook *orderBook)
+{
+	writer.write(orderBook->_symbolId);
+	writer.write(orderBook->_topOfBookOnly);
+	writer.write(orderBook->_topOfBookFlag);
+	writer.write(orderBook->_price);
+	writer.write(orderBook->_quoteSize);
+	writer.write(nanoseconds(orderBook->_quoteTime));
+	for (int side = 0; side < 2; ++side)
+	{
+		// levels from the top of book, orders in queue order
+		Intrusive::LinkedList &levelList = orderBook->_priceLevels[side];
+		uint32_t levelCnt(0);
+		for (Intrusive::LinkedListObject *obj = levelList.begin(); obj != levelList.end(); obj = obj->next())
+			++levelCnt;
+		writer.write(levelCnt);
+		for (Intrusive::LinkedListObject *obj = levelList.begin(); obj != levelList.end(); obj = obj->next())
+		{
+			PriceLevel *priceLevel = static_cast<PriceLevel*>(obj);
+			Intrusive::LinkedList &orderList = priceLevel->orders();
+			writer.write(priceLevel->price());
+			writer.write(static_cast<uint32_t>(priceLevel->orderCnt()));
+			for (Intrusive::LinkedListObject *orderObj = orderList.begin(); orderObj != orderList.end(); orderObj = orderObj->next())
+			{
+				BookOrder *bookOrder = static_cast<BookOrder*>(orderObj);
+				uint8_t kind = bookOrder->_order ? CheckpointOrder::Simulated : bookOrder == orderBook->_quoteOrders[side] ? CheckpointOrder::Quote : CheckpointOrder::Market;
+				writer.write(kind);
+				writer.write(bookOrder->_orderId);
+				writer.write(bookOrder->_shares);
+				writer.write(bookOrder->_marketShares);
+				writer.write(nanoseconds(bookOrder->_receivedTime));
+			}
+		}
+
+		// a quote order simulated orders took completely stays until the next quote replaces it
+		BookOrder *quoteOrder = orderBook->_quoteOrders[side];
+		uint8_t detached = quoteOrder && !quoteOrder->_priceLevel;
+		writer.write(detached);
+		if (detached)
+		{
+			writer.write(quoteOrder->_shares);
+			writer.write(nanoseconds(quoteOrder->_receivedTime));
+		}
+	}
+}
+
+bool ExchangeSimulator::checkpoint(FILE *file)
+{
+	CheckpointWriter writer(file);
+	writer.write(CheckpointMagic);
+	writer.write(CheckpointVersion);
+	writer.write(nanoseconds(_timeManager->time()));
+
+	uint32_t bookCnt(0);
+	for (OrderBook *orderBook : _orderBooks)
+		if (orderBook) ++bookCnt;
+	writer.write(bookCnt);
+	for (OrderBook *orderBook : _orderBooks)
+		if (orderBook) checkpointBook(writer, orderBook);
+
+	// market orders a simulated aggressor took completely stay known until the feed removes them
+	std::vector<BookOrder*> bookOrders;
+	if (_marketOrderTable) _marketOrderTable->forEach([&bookOrders](BookOrder *bookOrder) { if (!bookOrder->_priceLevel) bookOrders.push_back(bookOrder); });
+	writer.write(static_cast<uint32_t>(bookOrders.size()));
+	for (BookOrder *bookOrder : bookOrders)
+	{
+		// the book whose pool the order came from frees it
+		writer.write(bookOrder->_symbolId);
+		writer.write(bookOrder->_orderId);
+		writer.write(bookOrder->_shares);
+		writer.write(bookOrder->_marketShares);
+		writer.write(nanoseconds(bookOrder->_receivedTime));
+	}
+
+	// pending orders in arrival order, inserting them in this order rebuilds the wheel
+	_pendingOrders.objects(bookOrders);
+	writer.write(_pendingOrders.now());
+	writer.write(static_cast<uint32_t>(bookOrders.size()));
+	for (BookOrder *bookOrder : bookOrders)
+	{
+		writer.write(bookOrder->_order->clOrdId());
+		writer.write(bookOrder->_shares);
+		writer.write(bookOrder->wheelTime());
+	}
+	writer.write(_timeEventPending);
+	writer.write(nanoseconds(_timespec));
+
+	uint8_t latencyModel = _latencyModel != 0;
+	writer.write(latencyModel);
+	if (_latencyModel) _latencyModel->checkpoint(writer);
+	return writer.ok();
+}
+
+bool ExchangeSimulator::restoreBook(CheckpointReader &reader, OrderResolver &orderResolver)
+{
+	SymbolId symbolId;
+	bool topOfBookOnly, topOfBookFlag;
+	unsigned price[2], quoteSize[2];
+	uint64_t quoteTime;
+	if (!(reader.read(symbolId) && reader.read(topOfBookOnly) && reader.read(topOfBookFlag) && reader.read(price) && reader.read(quoteSize) && reader.read(quoteTime))) return false;
+
+	OrderBook *orderBook = this->orderBook(symbolId);
+	if (topOfBookOnly != orderBook->topOfBookOnly())
+	{
+		if (topOfBookOnly) orderBook->setTopOfBookOnly();
+		else orderBook->promote();
+	}
+
+	// orders rest as they were saved, matching them again would send fills
+	orderBook->_tradingMask = ~0U;
+	for (int side = 0; side < 2; ++side)
+	{
+		uint32_t levelCnt(0);
+		if (!reader.read(levelCnt)) return false;
+		for (uint32_t levelIdx = 0; levelIdx < levelCnt; ++levelIdx)
+		{
+			unsigned levelPrice(0);
+			uint32_t orderCnt(0);
+			if (!(reader.read(levelPrice) && reader.read(orderCnt))) return false;
+			for (uint32_t orderIdx = 0; orderIdx < orderCnt; ++orderIdx)
+			{
+				uint8_t kind;
+				uint64_t orderId, receivedTime;
+				unsigned shares, marketShares;
+				if (!(reader.read(kind) && reader.read(orderId) && reader.read(shares) && reader.read(marketShares) && reader.read(receivedTime))) return false;
+
+				BookOrder *bookOrder = orderBook->allocateBookOrder();
+				switch (kind)
+				{
+				case CheckpointOrder::Quote:
+					bookOrder->initialize(0, shares, toTimespec(receivedTime));
+					orderBook->_quoteOrders[side] = bookOrder;
+					break;
+				case CheckpointOrder::Market:
+					if (!_marketOrderTable) _marketOrderTable = new MarketOrderTable(_marketOrderCnt);
+					bookOrder->initialize(orderId, marketShares, toTimespec(receivedTime));
+					bookOrder->_shares = shares;
+					bookOrder->_symbolId = symbolId;
+					_marketOrderTable->insert(orderId, bookOrder);
+					break;
+				case CheckpointOrder::Simulated:
+				{
+					Order *order = orderResolver.order(orderId);
+					if (!order)
+					{
+						printf("%s %s %d: ERROR: %s clOrdId %llu not resolved\n", __FILE__, __FUNCTION__, __LINE__, _symbolRegistry->symbol(symbolId), static_cast<unsigned long long>(orderId));
+						orderBook->freeBookOrder(bookOrder);
+						return false;
+					}
+					bookOrder->initialize(orderId, shares, order, toTimespec(receivedTime));
+					_bookOrderTable.insert(orderId, bookOrder);
+					break;
+				}
+				default:
+					printf("%s %s %d: ERROR: unknown book order kind %d\n", __FILE__, __FUNCTION__, __LINE__, kind);
+					orderBook->freeBookOrder(bookOrder);
+					return false;
+				}
+				orderBook->newOrder(side, levelPrice, bookOrder);
+			}
+		}
+
+		uint8_t detached(0);
+		if (!reader.read(detached)) return false;
+		if (detached)
+		{
+			unsigned shares(0);
+			uint64_t receivedTime(0);
+			if (!(reader.read(shares) && reader.read(receivedTime))) return false;
+			BookOrder *quoteOrder = orderBook->allocateBookOrder();
+			quoteOrder->initialize(0, shares, toTimespec(receivedTime));
+			orderBook->_quoteOrders[side] = quoteOrder;
+		}
+	}
+	orderBook->_tradingMask = 0;
+
+	// the restored levels are the starting point, not changes to publish
+	orderBook->publishDepth(0);
+	orderBook->_topOfBookFlag = topOfBookFlag;
+	orderBook->_price[0] = price[0];
+	orderBook->_price[1] = price[1];
+	orderBook->_quoteSize[0] = quoteSize[0];
+	orderBook->_quoteSize[1] = quoteSize[1];
+	orderBook->_quoteTime = toTimespec(quoteTime);
+	return reader.ok();
+}
+
+bool ExchangeSimulator::restore(FILE *file, OrderResolver &orderResolver)
+{
+	// books from createOrderBooks are fine while they are empty
+	for (OrderBook *orderBook : _orderBooks)
+	{
+		if (orderBook && (orderBook->bid() != SideTraits<0>::EmptyPrice || orderBook->ask() != SideTraits<1>::EmptyPrice))
+		{
+			printf("%s %s %d: ERROR: restore into a simulator with orders\n", __FILE__, __FUNCTION__, __LINE__);
+			return false;
+		}
+	}
+
+	CheckpointReader reader(file);
+	uint32_t magic(0), version(0);
+	uint64_t time(0);
+	if (!(reader.read(magic) && magic == CheckpointMagic && reader.read(version) && version == CheckpointVersion && reader.read(time)))
+	{
+		printf("%s %s %d: ERROR: not a checkpoint of version %u\n", __FILE__, __FUNCTION__, __LINE__, CheckpointVersion);
+		return false;
+	}
+
+	uint32_t bookCnt(0);
+	reader.read(bookCnt);
+	for (uint32_t idx = 0; idx < bookCnt; ++idx)
+	{
+		if (!restoreBook(reader, orderResolver))
+		{
+			printf("%s %s %d: ERROR: book %u of %u not restored\n", __FILE__, __FUNCTION__, __LINE__, idx, bookCnt);
+			return false;
+		}
+	}
+	_depthChangedBooks.clear();
+
+	uint32_t bookOrderCnt(0);
+	reader.read(bookOrderCnt);
+	for (uint32_t idx = 0; idx < bookOrderCnt && reader.ok(); ++idx)
+	{
+		SymbolId symbolId;
+		uint64_t orderId, receivedTime;
+		unsigned shares, marketShares;
+		if (!(reader.read(symbolId) && reader.read(orderId) && reader.read(shares) && reader.read(marketShares) && reader.read(receivedTime))) break;
+		OrderBook *orderBook = findOrderBook(symbolId);
+		if (!orderBook)
+		{
+			printf("%s %s %d: ERROR: market order %llu without book\n", __FILE__, __FUNCTION__, __LINE__, static_cast<unsigned long long>(orderId));
+			return false;
+		}
+		if (!_marketOrderTable) _marketOrderTable = new MarketOrderTable(_marketOrderCnt);
+		BookOrder *bookOrder = orderBook->allocateBookOrder();
+		bookOrder->initialize(orderId, marketShares, toTimespec(receivedTime));
+		bookOrder->_shares = shares;
+		bookOrder->_symbolId = symbolId;
+		_marketOrderTable->insert(orderId, bookOrder);
+	}
+
+	uint64_t now(0);
+	uint32_t pendingCnt(0);
+	reader.read(now);
+	reader.read(pendingCnt);
+	_pendingOrders.reset(now);
+	for (uint32_t idx = 0; idx < pendingCnt && reader.ok(); ++idx)
+	{
+		uint64_t clOrdId, receivedTime;
+		unsigned shares;
+		if (!(reader.read(clOrdId) && reader.read(shares) && reader.read(receivedTime))) break;
+		Order *order = orderResolver.order(clOrdId);
+		if (!order)
+		{
+			printf("%s %s %d: ERROR: pending clOrdId %llu not resolved\n", __FILE__, __FUNCTION__, __LINE__, static_cast<unsigned long long>(clOrdId));
+			return false;
+		}
+		BookOrder *bookOrder = orderBook(order->symbolId())->allocateBookOrder();
+		bookOrder->initialize(clOrdId, shares, order, toTimespec(receivedTime));
+		_pendingOrders.insert(bookOrder);
+	}
+
+	bool timeEventPending(false);
+	uint64_t timeEventTime(0);
+	reader.read(timeEventPending);
+	reader.read(timeEventTime);
+	_timeManager->setTime(toTimespec(time));
+	if (timeEventPending)
+	{
+		_timespec = toTimespec(timeEventTime);
+		_timeManager->addCallback(this);
+		_timeEventPending = true;
+	}
+
+	uint8_t latencyModel(0);
+	reader.read(latencyModel);
+	if (latencyModel && (!_latencyModel || !_latencyModel->restore(reader)))
+	{
+		printf("%s %s %d: ERROR: latency model not restored\n", __FILE__, __FUNCTION__, __LINE__);
+		return false;
+	}
+	if (!reader.ok()) printf("%s %s %d: ERROR: checkpoint truncated\n", __FILE__, __FUNCTION__, __LINE__);
+	return reader.ok();
+}
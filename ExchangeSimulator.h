@@ -1,14 +1,17 @@
 #pragma once
 
+#include "SymbolRegistry.h"
+
 #include <time.h>
 
 struct Tick {
 	enum {
 		Quote = 0,
-		Trade = 1
+		Trade = 1,
+		MarketOrder = 2
 	};
 	int _type;
-	char _symbol[12];
+	SymbolId _symbolId;
 	timespec _ts;
 };
 
@@ -24,15 +27,142 @@ struct Trade : public Tick
 	unsigned _size;
 };
 
+/*
+** MarketOrder
+** - one message of an order by order feed keyed by the exchange's non zero order id
+** - side and price are used by add and modify, size is the new size for modify and the executed size for execute
+** - a symbol takes either quotes or market orders
+*/
+struct MarketOrder : public Tick
+{
+	enum
+	{
+		Add = 0,
+		Modify = 1,
+		Delete = 2,
+		Execute = 3
+	};
+	int _action;
+	uint64_t _orderId;
+	int _side;
+	unsigned _price;
+	unsigned _size;
+};
+
+#include "Checkpoint.h"
 #include "ExecutionReport.h"
+#include "LatencyModel.h"
+#include "MPSCQueue.h"
 #include "OrderBook.h"
+#include "SPSCBatchQueue.h"
+#include "SimulatorStats.h"
 #include "TimeManager.h"
+#include "TimingWheel.h"
 
+#include <algorithm>
 #include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+** RejectReason
+** - why the simulator rejected an order, the argument is the id the reason refers to
+*/
+struct RejectReason
+{
+	enum
+	{
+		None = 0,
+		// argument is the clOrdId
+		DuplicateClOrdId = 1,
+		// argument is the origClOrdId
+		UnknownOrigClOrdId = 2,
+		// argument is the msgType
+		UnhandledMsgType = 3
+	};
+};
+
+/*
+** SimulatorExecutionReport
+** - carries the symbol id, _symbol is not filled, use the symbol registry at the edges
+** - rejects carry a reason and argument, _text is empty until text() formats them
+*/
+struct SimulatorExecutionReport : public ExecutionReport
+{
+	SymbolId _symbolId;
+	int _rejectReason;
+	uint64_t _rejectArg;
+
+	const char *text();
+};
 
 struct ExecutionReportCallback
 {
-	virtual void onExecution(ExecutionReport &executionReport) = 0;
+	virtual void onExecution(SimulatorExecutionReport &executionReport) = 0;
+};
+
+/*
+** ExecutionReportQueue
+** - reports written in place by the simulator and drained by the consumer in batches
+*/
+typedef SPSCBatchQueue<SimulatorExecutionReport> ExecutionReportQueue;
+
+// deliver up to maxCnt queued reports on the consumer's thread, returns the number delivered
+inline size_t drainExecutionReports(ExecutionReportQueue &executionReportQueue, ExecutionReportCallback &callback, size_t maxCnt = ~static_cast<size_t>(0))
+{
+	size_t cnt(0);
+	while (cnt < maxCnt)
+	{
+		// one index load and one release per contiguous run of reports
+		unsigned batchCnt = static_cast<unsigned>(std::min<size_t>(maxCnt - cnt, executionReportQueue.capacity()));
+		SimulatorExecutionReport *executionReports = executionReportQueue.peek(batchCnt);
+		if (!executionReports) break;
+		for (unsigned idx = 0; idx < batchCnt; ++idx)
+			callback.onExecution(executionReports[idx]);
+		executionReportQueue.release(batchCnt);
+		cnt += batchCnt;
+	}
+	return cnt;
+}
+
+/*
+** OrderQueue
+** - order entry from algorithm threads, write returns false while the queue is full
+** - the simulator drains it before every tick in transact time and clOrdId order, so the reports
+**   do not depend on how the threads interleaved as long as a step's orders are written before its tick
+** - orders of different threads with the same transact time and clOrdId go in symbol, msgType, side, price,
+**   quantity and origClOrdId order, so the same one of them is rejected as a duplicate every time
+*/
+typedef MPSCQueue<Order*> OrderQueue;
+
+struct BookMemoryCallback
+{
+	virtual void onBookMemory(const OrderBook &orderBook, const BookMemory &bookMemory) = 0;
+};
+
+struct DepthCallback
+{
+	// conflated level changes for one book since its last update
+	virtual void onDepth(const OrderBook &orderBook, const DepthDelta *depthDeltas, size_t depthDeltaCnt, bool topOfBookChanged) = 0;
+};
+
+class ExchangeSimulator;
+
+/*
+** OrderResolver
+** - the caller's order for a clOrdId, restore points resting and pending simulated orders back at them
+*/
+struct OrderResolver
+{
+	virtual Order *order(uint64_t clOrdId) = 0;
+};
+
+struct CheckpointCallback
+{
+	// exchange holds every tick before ts, a restored run resumes with the first tick at or after ts
+	virtual void onCheckpoint(ExchangeSimulator &exchange, const timespec &ts) = 0;
 };
 
 class ExchangeSimulator: public TimeEventObject
@@ -46,40 +176,152 @@ protected:
 		}
 	};
 
-	struct OrderBookEqual
-	{
-		bool operator() (const char *symbol, const OrderBook &orderBook) const
-		{
-			return !strcmp(symbol, orderBook.symbol());
-		}
-	};
-
+	// orders wait in the timing wheel until their transact time plus latency
 	uint64_t _delayNanoseconds;
-	Intrusive::LinkedList _pendingOrderList;
+	LatencyModel *_latencyModel;
+	TimingWheel<BookOrder> _pendingOrders;
+	bool _timeEventPending;
 	Intrusive::LinkedObjectPool<BookOrder> _bookOrderAllocator;
 	Intrusive::LinkedObjectPool<PriceLevel> _priceLevelAllocator;
 
-	Intrusive::HashTable<const char*, OrderBook, OrderBookEqual> _orderBookTable;
 	Intrusive::HashTable<uint64_t, BookOrder, BookOrderEqual> _bookOrderTable;
 
+	struct MarketOrderHash
+	{
+		// exchange order ids are mostly sequential, mix them across the buckets
+		uint64_t operator() (const uint64_t &orderId) const
+		{
+			uint64_t hash = orderId * 0x9E3779B97F4A7C15ULL;
+			return hash ^ (hash >> 32);
+		}
+	};
+
+	// market orders of the order feed by exchange order id, created with the first market order
+	typedef Intrusive::HashTable<uint64_t, BookOrder, MarketOrderHash, BookOrderEqual> MarketOrderTable;
+	MarketOrderTable *_marketOrderTable;
+	size_t _marketOrderCnt;
+	// books indexed by symbol id, 0 until the symbol is first used or createOrderBooks,
+	// books come from a pool growing by the expected book count and live as long as the simulator
+	SymbolRegistry *_symbolRegistry;
+	std::vector<OrderBook*> _orderBooks;
+	Intrusive::ObjectPool<Intrusive::HashTableObject, OrderBook> _orderBookPool;
+
 	ExecutionReportCallback *_executionReportCallback;
+	ExecutionReportQueue *_executionReportQueue;
+	bool _waitForReportQueue;
+	uint64_t _droppedReportCnt;
 	TimeManager *_timeManager;
 
-	void status(char execType, char ordStatus, const char *text, Order *order);
+	// orders written by other threads and the batch being sorted
+	OrderQueue *_orderQueue;
+	std::vector<Order*> _queuedOrders;
+
+	// books with level changes waiting for publishDepth
+	DepthCallback *_depthCallback;
+	std::vector<OrderBook*> _depthChangedBooks;
+
+	// price ladder applied to new books
+	unsigned _ladderSize;
+	unsigned _ladderTickSize;
+
+	// per book arena sizes, 0 uses the shared pools
+	struct ArenaSize
+	{
+		size_t _priceLevelCnt;
+		size_t _bookOrderCnt;
+	};
+	ArenaSize _arenaSize;
+	std::unordered_map<SymbolId, ArenaSize> _arenaSizeHints;
+
+	// books stay top of book only while no simulated orders rest in them
+	bool _lazyTopOfBook;
+
+	int _tradeFillRule;
+
+	SimulatorStats _stats;
+
+	// next simulated time to call the checkpoint callback and the interval after it, 0 calls it once
+	CheckpointCallback *_checkpointCallback;
+	uint64_t _checkpointTime;
+	uint64_t _checkpointInterval;
+
+	OrderBook *createOrderBook(SymbolId symbolId);
+	OrderBook *findOrderBook(SymbolId symbolId) const { return symbolId < _orderBooks.size() ? _orderBooks[symbolId] : 0; }
+	OrderBook *orderBook(SymbolId symbolId);
+	void checkTopOfBookOnly(OrderBook *orderBook);
+	void scheduleTimeEvent(uint64_t time);
+	void publishDepth();
+	SimulatorExecutionReport &executionReport(SimulatorExecutionReport &localReport);
+	void deliver(SimulatorExecutionReport &executionReport, const SimulatorExecutionReport &localReport);
+	void status(char execType, char ordStatus, Order *order, int rejectReason = RejectReason::None, uint64_t rejectArg = 0);
+	void reject(Order *order, int rejectReason, uint64_t rejectArg);
+	void dispatch(const Tick &tick);
+	void drainOrders();
+	void checkpointDue(const timespec &ts);
+	void checkpointBook(CheckpointWriter &writer, OrderBook *orderBook);
+	bool restoreBook(CheckpointReader &reader, OrderResolver &orderResolver);
 public:
-	ExchangeSimulator(uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, TimeManager *timeManager);
+	ExchangeSimulator(uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, TimeManager *timeManager, SymbolRegistry *symbolRegistry);
+	const SymbolRegistry &symbols() const { return *_symbolRegistry; }
+	// stage timings and counters when built with SIMULATOR_STATS, dump them at the end of a run or at any time on the simulator's thread
+	SimulatorStats &stats() { return _stats; }
 
 	void setExecutionReportCallback(ExecutionReportCallback *callback) { _executionReportCallback = callback; }
+	// write reports into queue instead of calling the callback
+	// a full queue drops and counts the report unless wait is set: only a consumer on another thread may set it,
+	// a consumer draining on the simulator's thread never gets to run and the simulator waits for ever
+	void setExecutionReportQueue(ExecutionReportQueue *executionReportQueue, bool wait = false)
+	{
+		_executionReportQueue = executionReportQueue;
+		_waitForReportQueue = wait;
+	}
+	// reports dropped on a full execution report queue
+	uint64_t droppedExecutionReports() const { return _droppedReportCnt; }
+	// take orders from other threads through orderQueue as well as onOrder
+	void setOrderQueue(OrderQueue *orderQueue) { _orderQueue = orderQueue; }
+	// latency per order instead of the fixed delay, 0 restores the fixed delay
+	void setLatencyModel(LatencyModel *latencyModel) { _latencyModel = latencyModel; }
+	// depth updates once per tick or order batch, set before the first book is created
+	void setDepthCallback(DepthCallback *callback) { _depthCallback = callback; }
+	// index book price levels by tick over a window of size ticks, 0 walks the price level lists
+	void setPriceLadder(unsigned size, unsigned tickSize) { _ladderSize = size; _ladderTickSize = tickSize; }
+	// give each new book its own pools for levels and orders, growing by these counts unless the symbol has a hint
+	void setBookArena(size_t priceLevelCnt, size_t bookOrderCnt);
+	void setBookArenaHint(SymbolId symbolId, size_t priceLevelCnt, size_t bookOrderCnt);
+	// footprint and fragmentation of every book's arena, printed when callback is 0
+	void reportMemory(BookMemoryCallback *callback = 0);
+	// keep only the quote for books without simulated orders, top of book only books publish no depth:
+	// demotion publishes the removal of the levels left once and promotion adds the quote levels back
+	void setLazyTopOfBook(bool lazyTopOfBook) { _lazyTopOfBook = lazyTopOfBook; }
+	// TradeFillRule for simulated orders at a trade's price, QueuePosition by default
+	void setTradeFillRule(int tradeFillRule) { _tradeFillRule = tradeFillRule; }
+	// expected number of live market orders, set before the first market order
+	void setMarketOrderCnt(size_t marketOrderCnt) { _marketOrderCnt = marketOrderCnt; }
+	// create the books of the symbol universe in the registry after the book settings,
+	// every shardCnt symbol from shardIdx, so the first ticks of the session allocate nothing
+	void createOrderBooks(unsigned shardIdx = 0, unsigned shardCnt = 1);
+	// call callback before the first tick at or after ts and then every interval nanoseconds, 0 calls it once
+	void setCheckpoint(CheckpointCallback *callback, const timespec &ts, uint64_t intervalNanoseconds = 0);
+
+	// write the books, market and pending orders, time and latency model state, false on a write error
+	bool checkpoint(FILE *file);
+	// load a checkpoint into a simulator configured like the one that wrote it and not used yet,
+	// then replay from the first tick at or after the checkpoint time, clOrdIds must be unique
+	bool restore(FILE *file, OrderResolver &orderResolver);
 
 	void onTick(const Tick &tick);
+	// ticks in time order, the same reports and depth updates as onTick for each of them
+	void onTicks(const Tick *const *ticks, size_t tickCnt);
 	void onQuote(const Quote &quote);
 	void onOrder(Order *order);
 	void onTrade(const Trade &trade);
+	void onMarketOrder(const MarketOrder &marketOrder);
 	void timeEvent(const timespec &ts);
 	void execute(int side, unsigned price, unsigned shares, BookOrder *bookOrder);
 
-	PriceLevel *allocatePriceLevel() { return _priceLevelAllocator.allocate(); }
-	void freePriceLevel(PriceLevel *priceLevel) { _priceLevelAllocator.free(priceLevel); }
+	void depthChanged(OrderBook *orderBook) { _depthChangedBooks.push_back(orderBook); }
+
+	~ExchangeSimulator();
 private:
 	ExchangeSimulator(const ExchangeSimulator&) = delete;
 };
@@ -139,6 +139,15 @@ public:
 
 	size_t collisions(std::vector<size_t> &collisions);
 
+	// call function with every item, the table must not change meanwhile
+	template <typename Function>
+	void forEach(Function function) const
+	{
+		for (HashList *listItr = _listArray, *end = _listArray + _buckets; listItr < end; ++listItr)
+			for (HashTableObject *o = listItr->_next; o != listItr; o = o->_next)
+				function(static_cast<Type*>(o));
+	}
+
 	~HashTable()
 	{
 		if (_listArray) delete[] _listArray;
@@ -11,6 +11,7 @@ class ObjectPool
 protected:
 	BaseType *_next;
 	size_t _blockSize;
+	size_t _allocatedCnt;
 
 	struct Block
 	{
@@ -18,33 +19,44 @@ protected:
 		size_t _blockSize;
 		Type *_objects;
 
-		Type* initialize(size_t size);
+		Type* initialize(size_t size, BaseType *next);
 
 		~Block();
 	};
 	Block *_blocks;
+
+	// new block of size objects linked in front of next, returns its first object
+	Type *addBlock(size_t size, BaseType *next);
 public:
-	ObjectPool(size_t blockSize = 256) : _next(0), _blockSize(blockSize), _blocks(0) {}
+	ObjectPool(size_t blockSize = 256) : _next(0), _blockSize(blockSize), _allocatedCnt(0), _blocks(0) {}
 
 	Type *allocate();
 	void free(Type *object);
+	// allocate blocks up front so the next cnt allocations take no memory from the heap
+	void reserve(size_t cnt);
 
 	size_t blockCnt() const;
 	size_t blockSize() const { return _blockSize; }
+	// objects handed out and not yet freed
+	size_t allocatedCnt() const { return _allocatedCnt; }
+	// objects in all blocks
+	size_t capacity() const;
+	// memory held by all blocks
+	size_t bytes() const;
 	void setBlockSize(size_t blockSize) { _blockSize = blockSize; }
 
 	~ObjectPool();
 };
 
 template <typename BaseType, typename Type>
-Type* ObjectPool<BaseType, Type>::Block::initialize(size_t size)
+Type* ObjectPool<BaseType, Type>::Block::initialize(size_t size, BaseType *next)
 {
 	_blockSize = size;
 	Type *itr;
 	itr = _objects = new (static_cast<void*>(this + 1)) Type[_blockSize];
 	for (Type *end = _objects + _blockSize - 1; itr < end; ++itr)
 		static_cast<BaseType*>(itr)->_next = itr + 1;
-	static_cast<BaseType*>(itr)->_next = 0;
+	static_cast<BaseType*>(itr)->_next = next;
 	return _objects;
 }
 
@@ -56,23 +68,27 @@ ObjectPool<BaseType, Type>::Block::~Block()
 }
 
 template <typename BaseType, typename Type>
-Type* ObjectPool<BaseType, Type>::allocate()
+Type* ObjectPool<BaseType, Type>::addBlock(size_t size, BaseType *next)
 {
-	BaseType *object;
-	if (! (object = _next))
-	{
 #if _MSC_VER
-		Block *block = static_cast<Block*>(operator new (sizeof(Block) + sizeof(size_t) + _blockSize * sizeof(Type)));
+	Block *block = static_cast<Block*>(operator new (sizeof(Block) + sizeof(size_t) + size * sizeof(Type)));
 #else
-		Block *block = static_cast<Block*>(operator new (sizeof(Block) + _blockSize * sizeof(Type)));
+	Block *block = static_cast<Block*>(operator new (sizeof(Block) + size * sizeof(Type)));
 #endif
-		block->_next = _blocks;
-		_blocks = block;
+	block->_next = _blocks;
+	_blocks = block;
 
-		object = block->initialize(_blockSize);
-	}
+	return block->initialize(size, next);
+}
+
+template <typename BaseType, typename Type>
+Type* ObjectPool<BaseType, Type>::allocate()
+{
+	BaseType *object;
+	if (! (object = _next)) object = addBlock(_blockSize, 0);
 	_next = object->_next;
 	object->_next = object;
+	++_allocatedCnt;
 	return static_cast<Type*>(object);
 }
 
@@ -81,6 +97,15 @@ void ObjectPool<BaseType, Type>::free(Type *object)
 {
 	static_cast<BaseType*>(object)->_next = _next;
 	_next = object;
+	--_allocatedCnt;
+}
+
+template <typename BaseType, typename Type>
+void ObjectPool<BaseType, Type>::reserve(size_t cnt)
+{
+	// one block for the missing objects in front of the free ones
+	size_t freeCnt = capacity() - _allocatedCnt;
+	if (freeCnt < cnt) _next = addBlock(cnt - freeCnt, _next);
 }
 
 template <typename BaseType, typename Type>
@@ -91,6 +116,22 @@ size_t ObjectPool<BaseType, Type>::blockCnt() const
 	return cnt;
 }
 
+template <typename BaseType, typename Type>
+size_t ObjectPool<BaseType, Type>::capacity() const
+{
+	size_t cnt(0);
+	for (Block *block = _blocks; block; block = block->_next) cnt += block->_blockSize;
+	return cnt;
+}
+
+template <typename BaseType, typename Type>
+size_t ObjectPool<BaseType, Type>::bytes() const
+{
+	size_t cnt(0);
+	for (Block *block = _blocks; block; block = block->_next) cnt += sizeof(Block) + block->_blockSize * sizeof(Type);
+	return cnt;
+}
+
 template <typename BaseType, typename Type>
 ObjectPool<BaseType, Type>::~ObjectPool()
 {
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Checkpoint.h"
+#include "Order.h"
+
+#include <stdint.h>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+/*
+** LatencyModel
+** - nanoseconds from an order's transact time until it reaches the exchange simulator
+*/
+struct LatencyModel
+{
+	virtual uint64_t latency(const Order &order) = 0;
+	// models with state, such as a random generator, save it with the simulator checkpoint
+	virtual void checkpoint(CheckpointWriter &) {}
+	virtual bool restore(CheckpointReader &) { return true; }
+	virtual ~LatencyModel() {}
+};
+
+class FixedLatency : public LatencyModel
+{
+protected:
+	uint64_t _nanoseconds;
+public:
+	FixedLatency(uint64_t nanoseconds) : _nanoseconds(nanoseconds) {}
+	uint64_t latency(const Order &) { return _nanoseconds; }
+};
+
+/*
+** SymbolLatency
+** - latency by symbol id with a default for symbols without one
+*/
+class SymbolLatency : public LatencyModel
+{
+protected:
+	std::vector<uint64_t> _nanoseconds;
+	uint64_t _defaultNanoseconds;
+public:
+	SymbolLatency(uint64_t defaultNanoseconds) : _defaultNanoseconds(defaultNanoseconds) {}
+	void setLatency(SymbolId symbolId, uint64_t nanoseconds)
+	{
+		if (!(symbolId < _nanoseconds.size())) _nanoseconds.resize(symbolId + 1, _defaultNanoseconds);
+		_nanoseconds[symbolId] = nanoseconds;
+	}
+	uint64_t latency(const Order &order)
+	{
+		SymbolId symbolId = order.symbolId();
+		return symbolId < _nanoseconds.size() ? _nanoseconds[symbolId] : _defaultNanoseconds;
+	}
+};
+
+/*
+** AlgorithmLatency
+** - latency by the trading algorithm that sent the order with a default for the others
+*/
+class AlgorithmLatency : public LatencyModel
+{
+protected:
+	std::unordered_map<const TradingAlgorithm*, uint64_t> _nanoseconds;
+	uint64_t _defaultNanoseconds;
+public:
+	AlgorithmLatency(uint64_t defaultNanoseconds) : _defaultNanoseconds(defaultNanoseconds) {}
+	void setLatency(const TradingAlgorithm *tradingAlgorithm, uint64_t nanoseconds) { _nanoseconds[tradingAlgorithm] = nanoseconds; }
+	uint64_t latency(const Order &order)
+	{
+		std::unordered_map<const TradingAlgorithm*, uint64_t>::const_iterator itr = _nanoseconds.find(order.tradingAlgorithm());
+		return itr != _nanoseconds.end() ? itr->second : _defaultNanoseconds;
+	}
+};
+
+/*
+** JitterLatency
+** - adds uniform jitter in [0, maxJitter] to another model's latency
+** - seeded so a replay draws the same jitter for the same order sequence
+*/
+class JitterLatency : public LatencyModel
+{
+protected:
+	LatencyModel *_latencyModel;
+	std::mt19937_64 _random;
+	std::uniform_int_distribution<uint64_t> _jitter;
+public:
+	JitterLatency(LatencyModel *latencyModel, uint64_t maxJitter, uint64_t seed) : _latencyModel(latencyModel), _random(seed), _jitter(0, maxJitter) {}
+	uint64_t latency(const Order &order) { return _latencyModel->latency(order) + _jitter(_random); }
+	void checkpoint(CheckpointWriter &writer)
+	{
+		std::ostringstream state;
+		state << _random;
+		writer.write(state.str());
+		_latencyModel->checkpoint(writer);
+	}
+	bool restore(CheckpointReader &reader)
+	{
+		std::string state;
+		if (!reader.read(state)) return false;
+		std::istringstream(state) >> _random;
+		return _latencyModel->restore(reader);
+	}
+};
@@ -0,0 +1,150 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/*
+** MPMCQueue
+** - multi producer multi consumer ring with a sequence number per slot, as MPSCQueue with the read side claimed by CAS too
+** - slot at position p: sequence p is free for the producer of p, p + 1 is written, p + capacity is free for the next lap
+** - try calls never wait, they fail when the queue is full or empty or the next slot is still in use by a slower thread
+** - batch calls claim a run of positions with one CAS, then wait (yielding) for any slot in the run
+**   that a thread which claimed it earlier has not finished with yet
+*/
+template <typename T>
+class MPMCQueue
+{
+private:
+	struct Slot
+	{
+		std::atomic<unsigned> m_aSeq;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+
+		T* value() { return reinterpret_cast<T*>(&m_storage); }
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	unsigned m_capacity;
+	unsigned m_mask;
+	alignas(64) std::atomic<unsigned> m_aWriteIdx{ 0 };
+	alignas(64) std::atomic<unsigned> m_aReadIdx{ 0 };
+
+	MPMCQueue(const MPMCQueue&) = delete;
+	MPMCQueue& operator = (const MPMCQueue&) = delete;
+
+	void wait(Slot &slot, unsigned seq)
+	{
+		while (slot.m_aSeq.load(std::memory_order_acquire) != seq) std::this_thread::yield();
+	}
+public:
+	MPMCQueue(unsigned capacity) : m_slots(), m_capacity(std::pow(2, ceil(log2(capacity)))), m_mask(m_capacity - 1)
+	{
+		m_slots.reset(new Slot[m_capacity]);
+		for (unsigned idx = 0; idx < m_capacity; ++idx)
+			m_slots[idx].m_aSeq.store(idx, std::memory_order_relaxed);
+	}
+
+	~MPMCQueue()
+	{
+		// single threaded by now, every claimed position has been finished
+		for (unsigned read = m_aReadIdx.load(std::memory_order_relaxed), write = m_aWriteIdx.load(std::memory_order_relaxed); read != write; ++read)
+			m_slots[read & m_mask].value()->~T();
+	}
+
+	unsigned capacity() const { return m_capacity; }
+
+	template <typename... Args>
+	bool try_emplace(Args&&... args)
+	{
+		unsigned write = m_aWriteIdx.load(std::memory_order_relaxed);
+		Slot *slot;
+		for (;;)
+		{
+			slot = &m_slots[write & m_mask];
+			// acquire so the consumer of the previous lap is done with the slot
+			int diff = static_cast<int>(slot->m_aSeq.load(std::memory_order_acquire) - write);
+			if (!diff)
+			{
+				if (m_aWriteIdx.compare_exchange_weak(write, write + 1, std::memory_order_relaxed, std::memory_order_relaxed)) break;
+			}
+			else if (diff < 0) return false;
+			else write = m_aWriteIdx.load(std::memory_order_relaxed);
+		}
+		new (slot->value()) T(std::forward<Args>(args)...);
+		slot->m_aSeq.store(write + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool try_push(const T& t) { return try_emplace(t); }
+
+	bool try_pop(T& t)
+	{
+		unsigned read = m_aReadIdx.load(std::memory_order_relaxed);
+		Slot *slot;
+		for (;;)
+		{
+			slot = &m_slots[read & m_mask];
+			int diff = static_cast<int>(slot->m_aSeq.load(std::memory_order_acquire) - (read + 1));
+			if (!diff)
+			{
+				if (m_aReadIdx.compare_exchange_weak(read, read + 1, std::memory_order_relaxed, std::memory_order_relaxed)) break;
+			}
+			else if (diff < 0) return false;
+			else read = m_aReadIdx.load(std::memory_order_relaxed);
+		}
+		t = std::move(*slot->value());
+		slot->value()->~T();
+		slot->m_aSeq.store(read + m_capacity, std::memory_order_release);
+		return true;
+	}
+
+	// push up to cnt values, returns the number pushed, 0 while the queue is full
+	unsigned try_push(const T *values, unsigned cnt)
+	{
+		unsigned write = m_aWriteIdx.load(std::memory_order_relaxed);
+		unsigned claimCnt;
+		do
+		{
+			// consumers may have claimed past this write index already, then the whole ring is free
+			int used = static_cast<int>(write - m_aReadIdx.load(std::memory_order_relaxed));
+			claimCnt = m_capacity - (used > 0 ? used : 0);
+			if (claimCnt > cnt) claimCnt = cnt;
+			if (!claimCnt) return 0;
+		} while (!m_aWriteIdx.compare_exchange_weak(write, write + claimCnt, std::memory_order_relaxed, std::memory_order_relaxed));
+		for (unsigned idx = 0; idx < claimCnt; ++idx, ++write)
+		{
+			Slot &slot = m_slots[write & m_mask];
+			wait(slot, write);
+			new (slot.value()) T(values[idx]);
+			slot.m_aSeq.store(write + 1, std::memory_order_release);
+		}
+		return claimCnt;
+	}
+
+	// pop up to maxCnt values, returns the number popped, 0 while the queue is empty
+	unsigned try_pop(T *values, unsigned maxCnt)
+	{
+		unsigned read = m_aReadIdx.load(std::memory_order_relaxed);
+		unsigned claimCnt;
+		do
+		{
+			int available = static_cast<int>(m_aWriteIdx.load(std::memory_order_relaxed) - read);
+			claimCnt = available > 0 ? available : 0;
+			if (claimCnt > maxCnt) claimCnt = maxCnt;
+			if (!claimCnt) return 0;
+		} while (!m_aReadIdx.compare_exchange_weak(read, read + claimCnt, std::memory_order_relaxed, std::memory_order_relaxed));
+		for (unsigned idx = 0; idx < claimCnt; ++idx, ++read)
+		{
+			Slot &slot = m_slots[read & m_mask];
+			wait(slot, read + 1);
+			values[idx] = std::move(*slot.value());
+			slot.value()->~T();
+			slot.m_aSeq.store(read + m_capacity, std::memory_order_release);
+		}
+		return claimCnt;
+	}
+};
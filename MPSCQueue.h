@@ -1,53 +1,124 @@
 #pragma once
 #include <atomic>
 #include <cmath>
-#include <vector>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
-template <typename T>
+#include "WaitStrategy.h"
+
+/*
+** MPSCQueue
+** - multi producer single consumer ring, every slot carries a sequence number that says whose turn it is
+** - a producer claims a position with one CAS and publishes only its own slot, a slow producer holds back
+**   the reader at its slot but never lets it read an unwritten one, producers that finished later wait in their slots
+** - slot at position p: sequence p is free for the producer of p, p + 1 is written, p + capacity is free for the next lap
+** - values are constructed in place on write and destroyed on pop
+*/
+template <typename T, typename WaitStrategy = YieldWait>
 class MPSCQueue
 {
 private:
-	std::vector<T> m_buffer;
+	struct Slot
+	{
+		std::atomic<unsigned> m_aSeq;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+
+		T* value() { return reinterpret_cast<T*>(&m_storage); }
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
 	unsigned m_capacity;
 	unsigned m_mask;
-	unsigned m_nextWriteIdx{ 0 };
-	std::atomic<unsigned> m_aWriteIdx{ 0 };
-	std::atomic<unsigned> m_aWrite{ 0 };
-	std::atomic<unsigned> m_aNextWrite{ 0 };
-	alignas(64) std::atomic<unsigned> m_aReadIdx{ 0 };
-	unsigned m_readIdx{ 0 };
+	alignas(64) std::atomic<unsigned> m_aWriteIdx{ 0 };
+	// parking state the consumer writes, on a line of its own so it does not bounce the index lines
+	alignas(64) WaitStrategy m_waitStrategy;
+	alignas(64) unsigned m_readIdx{ 0 };
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator = (const MPSCQueue&) = delete;
 public:
-	MPSCQueue(unsigned capacity) : m_capacity(std::pow(2, ceil(log2(capacity)))), m_mask(m_capacity - 1)
+	MPSCQueue(unsigned capacity) : m_slots(), m_capacity(std::pow(2, ceil(log2(capacity)))), m_mask(m_capacity - 1)
 	{
-		m_buffer.resize(m_capacity);
+		m_slots.reset(new Slot[m_capacity]);
+		for (unsigned idx = 0; idx < m_capacity; ++idx)
+			m_slots[idx].m_aSeq.store(idx, std::memory_order_relaxed);
 	}
 
-	bool write(T& t)
+	~MPSCQueue()
 	{
-		unsigned write;
-		unsigned nextWrite;
-		unsigned nextWriteIdx;
-		do
+		while (front()) pop_front();
+	}
+
+	unsigned capacity() const { return m_capacity; }
+
+	// false while the queue is full
+	template <typename... Args>
+	bool emplace(Args&&... args)
+	{
+		unsigned write = m_aWriteIdx.load(std::memory_order_relaxed);
+		Slot *slot;
+		for (;;)
 		{
-			write = m_aWrite.load(std::memory_order_relaxed);
-			nextWrite = (write + 1);
-			nextWriteIdx = nextWrite & m_mask;
-			if (nextWriteIdx == m_aReadIdx.load(std::memory_order_relaxed)) return false;
-		} while (!m_aNextWrite.compare_exchange_weak(write, nextWrite, std::memory_order_relaxed, std::memory_order_relaxed));
-		m_buffer[write & m_mask] = t;
-		m_aWriteIdx.store(nextWriteIdx, std::memory_order_release);
-		m_aWrite.store(nextWrite, std::memory_order_relaxed);
+			slot = &m_slots[write & m_mask];
+			// acquire so the reader is done with the previous lap's value
+			int diff = static_cast<int>(slot->m_aSeq.load(std::memory_order_acquire) - write);
+			if (!diff)
+			{
+				if (m_aWriteIdx.compare_exchange_weak(write, write + 1, std::memory_order_relaxed, std::memory_order_relaxed)) break;
+			}
+			else if (diff < 0) return false;
+			else write = m_aWriteIdx.load(std::memory_order_relaxed);
+		}
+		new (slot->value()) T(std::forward<Args>(args)...);
+		slot->m_aSeq.store(write + 1, std::memory_order_release);
+		m_waitStrategy.notify(slot->m_aSeq);
 		return true;
 	}
 
+	bool write(const T& t) { return emplace(t); }
+
 	T* front()
 	{
-		return m_readIdx != m_aWriteIdx.load(std::memory_order_acquire) ? &m_buffer[m_readIdx] : nullptr;
+		Slot &slot = m_slots[m_readIdx & m_mask];
+		return slot.m_aSeq.load(std::memory_order_acquire) == m_readIdx + 1 ? slot.value() : nullptr;
 	}
 
 	void pop_front()
 	{
-		m_readIdx = (m_readIdx + 1) & m_mask;
-		m_aReadIdx.store(m_readIdx, std::memory_order_relaxed);
+		Slot &slot = m_slots[m_readIdx & m_mask];
+		slot.value()->~T();
+		slot.m_aSeq.store(m_readIdx + m_capacity, std::memory_order_release);
+		++m_readIdx;
+	}
+
+	// front, waiting up to timeoutNanoseconds for a producer to write the next slot, nullptr on timeout
+	T* front_wait(uint64_t timeoutNanoseconds = ~0ULL)
+	{
+		T *t = front();
+		// the next slot's sequence stays at the read index until it is written
+		if (!t) m_waitStrategy.wait(m_slots[m_readIdx & m_mask].m_aSeq, m_readIdx, [this, &t] { return (t = front()) != nullptr; }, timeoutNanoseconds);
+		return t;
+	}
+
+	// move the next value out, waiting for the producers as long as it takes
+	void pop_wait(T& t)
+	{
+		t = std::move(*front_wait());
+		pop_front();
+	}
+
+	// hand up to maxCnt written values to function(T&) and pop them, returns the number drained
+	template <typename Function>
+	unsigned drain(Function function, unsigned maxCnt = ~0U)
+	{
+		unsigned cnt(0);
+		for (T *value; cnt < maxCnt && (value = front()); ++cnt)
+		{
+			function(*value);
+			pop_front();
+		}
+		return cnt;
 	}
 };
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "BitOps.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+** OccupancyBitmap
+** - one bit per slot with a summary bit per 64 bit word
+** - finds the next or previous occupied slot and counts occupied slots with word wide bit scans
+*/
+class OccupancyBitmap
+{
+protected:
+	uint64_t *_words;
+	uint64_t *_summary;
+	unsigned _size;
+	unsigned _wordCnt;
+	unsigned _summaryCnt;
+public:
+	static const int NotFound = -1;
+
+	OccupancyBitmap(): _words(0), _summary(0), _size(0), _wordCnt(0), _summaryCnt(0) {}
+	void initialize(unsigned size);
+	unsigned size() const { return _size; }
+
+	bool test(unsigned slot) const { return (_words[slot >> 6] >> (slot & 63)) & 1; }
+	void set(unsigned slot);
+	void reset(unsigned slot);
+	void clear();
+	bool empty() const;
+
+	// first occupied slot at or after slot
+	int next(unsigned slot) const;
+	// last occupied slot at or before slot
+	int prev(unsigned slot) const;
+	// occupied slots in [first, last]
+	unsigned count(unsigned first, unsigned last) const;
+
+	~OccupancyBitmap() { delete[] _words; delete[] _summary; }
+private:
+	OccupancyBitmap(const OccupancyBitmap&) = delete;
+	OccupancyBitmap& operator = (const OccupancyBitmap&) = delete;
+};
+
+inline
+void OccupancyBitmap::initialize(unsigned size)
+{
+	delete[] _words;
+	delete[] _summary;
+	_size = size;
+	_wordCnt = (size + 63) >> 6;
+	_summaryCnt = (_wordCnt + 63) >> 6;
+	_words = _wordCnt ? new uint64_t[_wordCnt]() : 0;
+	_summary = _summaryCnt ? new uint64_t[_summaryCnt]() : 0;
+}
+
+inline
+void OccupancyBitmap::set(unsigned slot)
+{
+	unsigned word = slot >> 6;
+	_words[word] |= 1ULL << (slot & 63);
+	_summary[word >> 6] |= 1ULL << (word & 63);
+}
+
+inline
+void OccupancyBitmap::reset(unsigned slot)
+{
+	unsigned word = slot >> 6;
+	if (!(_words[word] &= ~(1ULL << (slot & 63))))
+		_summary[word >> 6] &= ~(1ULL << (word & 63));
+}
+
+inline
+void OccupancyBitmap::clear()
+{
+	memset(_words, 0, _wordCnt * sizeof(uint64_t));
+	memset(_summary, 0, _summaryCnt * sizeof(uint64_t));
+}
+
+inline
+bool OccupancyBitmap::empty() const
+{
+	for (const uint64_t *itr = _summary, *end = _summary + _summaryCnt; itr < end; ++itr)
+		if (*itr) return false;
+	return true;
+}
+
+inline
+int OccupancyBitmap::next(unsigned slot) const
+{
+	if (!(slot < _size)) return NotFound;
+
+	// rest of the current word
+	unsigned word = slot >> 6;
+	uint64_t bits = _words[word] & (~0ULL << (slot & 63));
+	if (bits) return static_cast<int>((word << 6) + lowestBit(bits));
+
+	// next occupied word from the summary
+	if (!(++word < _wordCnt)) return NotFound;
+	unsigned summaryWord = word >> 6;
+	uint64_t summaryBits = _summary[summaryWord] & (~0ULL << (word & 63));
+	for (;;)
+	{
+		if (summaryBits)
+		{
+			word = (summaryWord << 6) + lowestBit(summaryBits);
+			return static_cast<int>((word << 6) + lowestBit(_words[word]));
+		}
+		if (!(++summaryWord < _summaryCnt)) return NotFound;
+		summaryBits = _summary[summaryWord];
+	}
+}
+
+inline
+int OccupancyBitmap::prev(unsigned slot) const
+{
+	if (!_size) return NotFound;
+	if (!(slot < _size)) slot = _size - 1;
+
+	// rest of the current word
+	unsigned word = slot >> 6;
+	uint64_t bits = _words[word] & (~0ULL >> (63 - (slot & 63)));
+	if (bits) return static_cast<int>((word << 6) + highestBit(bits));
+
+	// previous occupied word from the summary
+	if (!word) return NotFound;
+	--word;
+	unsigned summaryWord = word >> 6;
+	uint64_t summaryBits = _summary[summaryWord] & (~0ULL >> (63 - (word & 63)));
+	for (;;)
+	{
+		if (summaryBits)
+		{
+			word = (summaryWord << 6) + highestBit(summaryBits);
+			return static_cast<int>((word << 6) + highestBit(_words[word]));
+		}
+		if (!summaryWord) return NotFound;
+		summaryBits = _summary[--summaryWord];
+	}
+}
+
+inline
+unsigned OccupancyBitmap::count(unsigned first, unsigned last) const
+{
+	if (!_size || first > last) return 0;
+	if (!(last < _size)) last = _size - 1;
+
+	unsigned firstWord = first >> 6, lastWord = last >> 6;
+	uint64_t firstMask = ~0ULL << (first & 63), lastMask = ~0ULL >> (63 - (last & 63));
+	if (firstWord == lastWord) return popCount(_words[firstWord] & firstMask & lastMask);
+
+	unsigned cnt = popCount(_words[firstWord] & firstMask) + popCount(_words[lastWord] & lastMask);
+	for (unsigned word = firstWord + 1; word < lastWord; ++word)
+		cnt += popCount(_words[word]);
+	return cnt;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "FixSide.h"
+#include "SymbolRegistry.h"
+
 #include <stdint.h>
 
 class TradingAlgorithm;
@@ -10,7 +13,7 @@ protected:
 	struct ChainCommon
 	{
 		TradingAlgorithm *_tradingAlgorithm;
-		char _symbol[12];
+		SymbolId _symbolId;
 		char _side;
 		unsigned _sideId;
 
@@ -31,8 +34,10 @@ protected:
 	Order *_original;
 	Order *_replacement;
 public:
-	int newOrder(const char *symbol, char side, unsigned orderQty, unsigned price, const timespec &ts);
-	const char *symbol() const { return _chainCommon->_symbol; }
+	// starts a new order chain on the chain common record the owner attached, -1 without one
+	int newOrder(SymbolId symbolId, char side, unsigned orderQty, unsigned price, const timespec &ts);
+	SymbolId symbolId() const { return _chainCommon->_symbolId; }
+	const TradingAlgorithm *tradingAlgorithm() const { return _chainCommon->_tradingAlgorithm; }
 	char side() const { return _chainCommon->_side; }
 	int sideId() const { return _chainCommon->_sideId; }
 	unsigned msgType() const { return _msgType; }
@@ -46,8 +51,15 @@ public:
 };
 
 inline
-int Order::newOrder(const char *symbol, char side, unsigned orderQty, unsigned price, const timespec &ts)
+int Order::newOrder(SymbolId symbolId, char side, unsigned orderQty, unsigned price, const timespec &ts)
 {
+	if (!_chainCommon) return -1;
+	_chainCommon->_symbolId = symbolId;
+	_chainCommon->_side = side;
+	_chainCommon->_sideId = FIX::Side::sideId(side);
+	_chainCommon->_completed = false;
+	_chainCommon->_cumQty = _chainCommon->_exchangeCumQty = 0;
+
 	_clOrdId = 0;
 	_orderQty = orderQty;
 	_price = price;
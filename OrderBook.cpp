@@ -14,103 +14,522 @@ public:
 	void freePriceLevel(PriceLevel *priceLevel) { delete priceLevel; }
 };
 
-namespace
-{
-	bool higher(unsigned l, unsigned r) { return l > r; }
-	bool lower(unsigned l, unsigned r) { return l < r; }
-}
-
 inline
 void OrderBook::execute(int side, unsigned price, unsigned shares, BookOrder *order)
 {
 	_exchange->execute(side, price, shares, order);
 }
 
-bool PriceLevel::execute(int side, BookOrder * order)
+template <int SIDE>
+bool PriceLevel::execute(BookOrder * order)
 {
 	// execute if the quote crosses a simulated order
 	// if the quote is crossed use newer data
 	bool filled(false);
-	int levelSide = (side + 1) & 1;
+	const int levelSide = SideTraits<SIDE>::OtherSide;
 	for (Intrusive::LinkedListObject *obj = _orders.begin(); ! filled && obj != _orders.end(); obj = _orders.begin())
 	{
 		BookOrder *levelOrder = static_cast<BookOrder*>(obj);
-		if (order->_order)
+		// simulated orders take market orders and market orders of the order feed take simulated orders,
+		// neither takes more than its own shares, a quote takes the whole level
+		if (order->_order ? levelOrder->_orderId != 0 : order->_orderId && levelOrder->_order)
 		{
-			if (levelOrder->_orderId)
+			if (order->_shares < levelOrder->_shares)
 			{
-				if (order->_shares < levelOrder->_shares)
-				{
-					filled = true;
-					_shares -= order->_shares;
-					_orderBook->execute(side, _price, order->_shares, order);
-					_orderBook->execute(levelSide, _price, order->_shares, levelOrder);
-					break;
-				}
-				else
-				{
-					filled = order->_shares == levelOrder->_shares;
-					_orderBook->execute(side, _price, levelOrder->_shares, order);
-				}
+				filled = true;
+				_shares -= order->_shares;
+				_orderBook->levelChanged(this);
+				// executing order clears its shares
+				unsigned shares = order->_shares;
+				_orderBook->execute(SIDE, _price, shares, order);
+				_orderBook->execute(levelSide, _price, shares, levelOrder);
+				break;
 			}
 			else
 			{
-				filled = true;
-				_orderBook->execute(side, _price, order->_shares, order);
-				break;
+				filled = order->_shares == levelOrder->_shares;
+				_orderBook->execute(SIDE, _price, levelOrder->_shares, order);
 			}
 		}
+		else if (order->_order)
+		{
+			filled = true;
+			_orderBook->execute(SIDE, _price, order->_shares, order);
+			break;
+		}
 		removeBookOrder(levelOrder);
 		_orderBook->execute(levelSide, _price, levelOrder->_shares, levelOrder);
+		// quote orders stay with the book until the next quote
+		if (levelOrder->_order) _orderBook->freeBookOrder(levelOrder);
 	}
 	return filled;
 }
 
-void OrderBook::initialize(ExchangeSimulator * exchange, const char * symbol)
+template <int SIDE>
+unsigned PriceLevel::trade(unsigned shares, bool queuePosition, Intrusive::LinkedListObject *end)
+{
+	for (Intrusive::LinkedListObject *obj = _orders.begin(); shares && _simulatedCnt && obj != end;)
+	{
+		BookOrder *levelOrder = static_cast<BookOrder*>(obj);
+		obj = obj->next();
+		if (!levelOrder->_order)
+		{
+			// the print went to the market order first
+			if (queuePosition) shares -= shares < levelOrder->_shares ? shares : levelOrder->_shares;
+			continue;
+		}
+
+		unsigned fillShares = shares < levelOrder->_shares ? shares : levelOrder->_shares;
+		shares -= fillShares;
+		if (fillShares == levelOrder->_shares)
+		{
+			removeBookOrder(levelOrder);
+			_orderBook->execute(SIDE, _price, fillShares, levelOrder);
+			_orderBook->freeBookOrder(levelOrder);
+		}
+		else
+		{
+			_shares -= fillShares;
+			_orderBook->levelChanged(this);
+			_orderBook->execute(SIDE, _price, fillShares, levelOrder);
+		}
+	}
+	return shares;
+}
+
+void PriceLadder::initialize(int side, unsigned size, unsigned tickSize)
+{
+	// levels keep their list position only
+	for (int s = _size ? _occupied.next(0) : -1; s >= 0; s = _occupied.next(s + 1))
+		_levels[s]->_slot = -1;
+	delete[] _levels;
+	_side = side;
+	_size = size;
+	_tickSize = tickSize ? tickSize : 1;
+	_base = 0;
+	_levels = _size ? new PriceLevel*[_size]() : 0;
+	_occupied.initialize(_size);
+	_depth.initialize(_size);
+}
+
+template <int SIDE>
+void PriceLadder::recenter(unsigned price, Intrusive::LinkedList &levelList)
+{
+	// keep an eighth of the window inside of the top of book
+	unsigned insideSlots = _size / 8;
+	unsigned outsideSlots = _size - 1 - insideSlots;
+	unsigned belowSlots = SIDE ? insideSlots : outsideSlots;
+	_base = price / _tickSize < belowSlots ? price % _tickSize : price - belowSlots * _tickSize;
+
+	for (int s = _occupied.next(0); s >= 0; s = _occupied.next(s + 1))
+		_levels[s]->_slot = -1;
+	memset(_levels, 0, _size * sizeof(PriceLevel*));
+	_occupied.clear();
+	_depth.clear();
+	for (Intrusive::LinkedListObject *obj = levelList.begin(); obj != levelList.end(); obj = obj->next())
+	{
+		PriceLevel *priceLevel = static_cast<PriceLevel*>(obj);
+		int s = slot(priceLevel->price());
+		if (s < 0)
+		{
+			// levels are sorted from the top of book out, stop once past the outside edge
+			if (SIDE ? priceLevel->price() > _base : priceLevel->price() < _base) break;
+			continue;
+		}
+		set(s, priceLevel);
+	}
+}
+
+void OrderBook::initialize(ExchangeSimulator * exchange, SymbolId symbolId)
 {
 	_exchange = exchange;
-	strncpy(_symbol, symbol, sizeof(_symbol));
+	_symbolId = symbolId;
+	_stats = &exchange->stats();
 	_tradingMask = 0;
-	_price[0] = 0;
-	_price[1] = -1;
+	_price[0] = SideTraits<0>::EmptyPrice;
+	_price[1] = SideTraits<1>::EmptyPrice;
 }
 
-bool OrderBook::newOrder(int side, unsigned price, BookOrder *order)
+void OrderBook::setAllocators(Intrusive::LinkedObjectPool<PriceLevel> *priceLevelAllocator, Intrusive::LinkedObjectPool<BookOrder> *bookOrderAllocator)
+{
+	_priceLevelAllocator = priceLevelAllocator;
+	_bookOrderAllocator = bookOrderAllocator;
+}
+
+void OrderBook::setArena(size_t priceLevelCnt, size_t bookOrderCnt)
+{
+	_priceLevelPool.setBlockSize(priceLevelCnt);
+	_bookOrderPool.setBlockSize(bookOrderCnt);
+	_priceLevelAllocator = &_priceLevelPool;
+	_bookOrderAllocator = &_bookOrderPool;
+}
+
+void OrderBook::reserve(size_t depthDeltaCnt)
+{
+	if (_priceLevelAllocator == &_priceLevelPool) _priceLevelPool.reserve(_priceLevelPool.blockSize());
+	if (_bookOrderAllocator == &_bookOrderPool) _bookOrderPool.reserve(_bookOrderPool.blockSize());
+	if (_depthTracking)
+	{
+		_depthDeltas.reserve(depthDeltaCnt);
+		_depthLevels.reserve(depthDeltaCnt);
+		resizeDepthDeltaSlots(depthDeltaCnt);
+	}
+}
+
+void OrderBook::memory(BookMemory &bookMemory) const
+{
+	bookMemory._bytes = _priceLevelPool.bytes() + _bookOrderPool.bytes();
+	bookMemory._blockCnt = _priceLevelPool.blockCnt() + _bookOrderPool.blockCnt();
+	bookMemory._priceLevelCnt = _priceLevelPool.allocatedCnt();
+	bookMemory._priceLevelCapacity = _priceLevelPool.capacity();
+	bookMemory._bookOrderCnt = _bookOrderPool.allocatedCnt();
+	bookMemory._bookOrderCapacity = _bookOrderPool.capacity();
+}
+
+void OrderBook::setPriceLadder(unsigned size, unsigned tickSize)
+{
+	_ladder[0].initialize(0, size, tickSize);
+	_ladder[1].initialize(1, size, tickSize);
+	if (size && !_priceLevels[0].empty()) _ladder[0].recenter<0>(_price[0], _priceLevels[0]);
+	if (size && !_priceLevels[1].empty()) _ladder[1].recenter<1>(_price[1], _priceLevels[1]);
+}
+
+OrderBook::DepthDeltaSlot &OrderBook::depthDeltaSlot(int side, unsigned price)
+{
+	// odd multiplier, neighbouring prices land in different slots
+	size_t mask = _depthDeltaSlots.size() - 1;
+	for (size_t idx = ((2 * price + side) * 2654435761U) & mask; ; idx = (idx + 1) & mask)
+	{
+		DepthDeltaSlot &slot = _depthDeltaSlots[idx];
+		if (slot._generation != _depthGeneration) return slot;
+		const DepthDelta &depthDelta = _depthDeltas[slot._deltaIdx];
+		if (depthDelta._side == side && depthDelta._price == price) return slot;
+	}
+}
+
+void OrderBook::resizeDepthDeltaSlots(size_t depthDeltaCnt)
+{
+	size_t size = 16;
+	while (size < 2 * depthDeltaCnt) size *= 2;
+	if (size <= _depthDeltaSlots.size()) return;
+	DepthDeltaSlot empty = { 0, -1 };
+	_depthDeltaSlots.assign(size, empty);
+	for (size_t idx = 0; idx < _depthDeltas.size(); ++idx)
+	{
+		DepthDeltaSlot &slot = depthDeltaSlot(_depthDeltas[idx]._side, _depthDeltas[idx]._price);
+		slot._generation = _depthGeneration;
+		slot._deltaIdx = static_cast<int>(idx);
+	}
+}
+
+void OrderBook::addDepthDelta(PriceLevel *priceLevel)
+{
+	if (_depthDeltas.empty()) _exchange->depthChanged(this);
+	resizeDepthDeltaSlots(_depthDeltas.size() + 1);
+
+	DepthDeltaSlot &slot = depthDeltaSlot(priceLevel->_side, priceLevel->_price);
+	if (slot._generation == _depthGeneration)
+	{
+		// a level removed and added again in the same batch keeps its delta
+		_depthLevels[slot._deltaIdx] = priceLevel;
+		priceLevel->_deltaIdx = slot._deltaIdx;
+		return;
+	}
+
+	DepthDelta depthDelta = { priceLevel->_side, priceLevel->_price, 0, 0 };
+	slot._generation = _depthGeneration;
+	slot._deltaIdx = static_cast<int>(_depthDeltas.size());
+	priceLevel->_deltaIdx = slot._deltaIdx;
+	_depthDeltas.push_back(depthDelta);
+	_depthLevels.push_back(priceLevel);
+}
+
+template <int SIDE>
+void OrderBook::freePriceLevel(PriceLevel *priceLevel)
+{
+	if (_ladder[SIDE].enabled()) _ladder[SIDE].remove(priceLevel);
+	if (priceLevel->_deltaIdx >= 0)
+	{
+		DepthDelta &depthDelta = _depthDeltas[priceLevel->_deltaIdx];
+		depthDelta._shares = depthDelta._orderCnt = 0;
+		_depthLevels[priceLevel->_deltaIdx] = 0;
+	}
+	priceLevel->unlink();
+	_priceLevelAllocator->free(priceLevel);
+}
+
+void OrderBook::publishDepth(DepthCallback *callback)
 {
-	bool(*inside) (unsigned, unsigned) = side ? lower : higher;
+	for (size_t idx = 0; idx < _depthDeltas.size(); ++idx)
+	{
+		PriceLevel *priceLevel = _depthLevels[idx];
+		if (priceLevel)
+		{
+			DepthDelta &depthDelta = _depthDeltas[idx];
+			depthDelta._shares = priceLevel->_shares;
+			depthDelta._orderCnt = priceLevel->_orderCnt;
+			priceLevel->_deltaIdx = -1;
+		}
+	}
+	if (callback && !_depthDeltas.empty()) callback->onDepth(*this, _depthDeltas.data(), _depthDeltas.size(), _topOfBookFlag);
+	_depthDeltas.clear();
+	_depthLevels.clear();
+	// every slot goes stale, on wrap around they are cleared for real
+	if (!++_depthGeneration)
+	{
+		DepthDeltaSlot empty = { 0, -1 };
+		_depthDeltaSlots.assign(_depthDeltaSlots.size(), empty);
+		_depthGeneration = 1;
+	}
+	_topOfBookFlag = false;
+}
+
+template <int SIDE>
+void OrderBook::setTopOfBook()
+{
+	Intrusive::LinkedList &levelList = _priceLevels[SIDE];
+	Intrusive::LinkedListObject *obj = levelList.begin();
+	if (obj != levelList.end())
+	{
+		_price[SIDE] = static_cast<PriceLevel*>(obj)->_price;
+		PriceLadder &ladder = _ladder[SIDE];
+		if (ladder.enabled() && ladder.slot(_price[SIDE]) < 0) ladder.recenter<SIDE>(_price[SIDE], levelList);
+	}
+	else _price[SIDE] = SideTraits<SIDE>::EmptyPrice;
+	_topOfBookFlag = true;
+}
+
+template <int SIDE>
+void OrderBook::nextTopOfBook()
+{
+	// once the top of book level is gone no level can be inside of the window
+	PriceLadder &ladder = _ladder[SIDE];
+	int s;
+	if (ladder.enabled() && (s = ladder.top<SIDE>()) >= 0)
+	{
+		_price[SIDE] = ladder.price(s);
+		_topOfBookFlag = true;
+	}
+	else setTopOfBook<SIDE>();
+}
+
+template <int SIDE>
+PriceLevel *OrderBook::levelAtOrInside(unsigned price)
+{
+	PriceLadder &ladder = _ladder[SIDE];
+	int s;
+	if (ladder.enabled() && (s = ladder.slot(price)) >= 0)
+	{
+		s = ladder.atOrInside<SIDE>(s);
+		return s >= 0 ? ladder.level(s) : 0;
+	}
+
+	// walk out from the top of book
+	PriceLevel *priceLevel(0);
+	Intrusive::LinkedList &levelList = _priceLevels[SIDE];
+	for (Intrusive::LinkedListObject *obj = levelList.begin(); obj != levelList.end(); obj = obj->next())
+	{
+		PriceLevel *level = static_cast<PriceLevel*>(obj);
+		if (SideTraits<SIDE>::inside(price, level->_price)) break;
+		priceLevel = level;
+	}
+	return priceLevel;
+}
+
+PriceLevel *OrderBook::levelAtOrInside(int side, unsigned price)
+{
+	return side ? levelAtOrInside<1>(price) : levelAtOrInside<0>(price);
+}
+
+unsigned OrderBook::levelCount(int side, unsigned price1, unsigned price2)
+{
+	if (price1 > price2)
+	{
+		unsigned price = price1;
+		price1 = price2;
+		price2 = price;
+	}
+
+	PriceLadder &ladder = _ladder[side];
+	int s1, s2;
+	if (ladder.enabled() && (s1 = ladder.slot(price1)) >= 0 && (s2 = ladder.slot(price2)) >= 0)
+		return ladder.count(s1, s2);
+
+	unsigned cnt(0);
+	Intrusive::LinkedList &levelList = _priceLevels[side];
+	for (Intrusive::LinkedListObject *obj = levelList.begin(); obj != levelList.end(); obj = obj->next())
+	{
+		unsigned levelPrice = static_cast<PriceLevel*>(obj)->_price;
+		if (side ? levelPrice > price2 : levelPrice < price1) break;
+		if (price1 <= levelPrice && levelPrice <= price2) ++cnt;
+	}
+	return cnt;
+}
+
+template <int SIDE>
+Intrusive::LinkedListObject *OrderBook::outsideLadder()
+{
+	// first level past the most outside level of the window
+	PriceLadder &ladder = _ladder[SIDE];
+	int s = ladder.bottom<SIDE>();
+	return s >= 0 ? ladder.level(s)->next() : _priceLevels[SIDE].begin();
+}
+
+template <int SIDE>
+uint64_t OrderBook::sharesAtOrInside(unsigned price)
+{
+	uint64_t shares(0);
+	Intrusive::LinkedList &levelList = _priceLevels[SIDE];
+	Intrusive::LinkedListObject *obj = levelList.begin();
+	PriceLadder &ladder = _ladder[SIDE];
+	if (ladder.enabled())
+	{
+		int s = ladder.slot(price);
+		if (s >= 0) return ladder.depth().sum(ladder.depthIndex(s) + 1)._shares;
+
+		// past the outside edge take the whole window and walk the rest
+		if (ladder.outside<SIDE>(price))
+		{
+			shares = ladder.depth().total()._shares;
+			obj = outsideLadder<SIDE>();
+		}
+	}
+
+	for (; obj != levelList.end(); obj = obj->next())
+	{
+		PriceLevel *priceLevel = static_cast<PriceLevel*>(obj);
+		if (SideTraits<SIDE>::inside(price, priceLevel->_price)) break;
+		shares += priceLevel->_shares;
+	}
+	return shares;
+}
+
+uint64_t OrderBook::sharesAtOrInside(int side, unsigned price)
+{
+	return side ? sharesAtOrInside<1>(price) : sharesAtOrInside<0>(price);
+}
+
+template <int SIDE>
+bool OrderBook::sweepCost(uint64_t shares, SweepCost &cost)
+{
+	cost._shares = cost._notional = 0;
+	cost._lastPrice = SideTraits<SIDE>::EmptyPrice;
+	if (!shares) return true;
+
+	Intrusive::LinkedList &levelList = _priceLevels[SIDE];
+	Intrusive::LinkedListObject *obj = levelList.begin();
+	PriceLadder &ladder = _ladder[SIDE];
+	if (ladder.enabled())
+	{
+		DepthSum before;
+		unsigned index = ladder.depth().lowerBound(shares, before);
+		if (index < ladder.size())
+		{
+			// the sweep completes at this level
+			PriceLevel *priceLevel = ladder.level(ladder.depthIndex(index));
+			cost._shares = shares;
+			cost._notional = before._notional + (shares - before._shares) * priceLevel->_price;
+			cost._lastPrice = priceLevel->_price;
+			return true;
+		}
+
+		// the window is not enough, continue past its outside edge
+		cost._shares = before._shares;
+		cost._notional = before._notional;
+		int s = ladder.bottom<SIDE>();
+		if (s >= 0) cost._lastPrice = ladder.price(s);
+		obj = outsideLadder<SIDE>();
+	}
+
+	for (; cost._shares < shares && obj != levelList.end(); obj = obj->next())
+	{
+		PriceLevel *priceLevel = static_cast<PriceLevel*>(obj);
+		uint64_t levelShares = shares - cost._shares;
+		if (levelShares > priceLevel->_shares) levelShares = priceLevel->_shares;
+		cost._shares += levelShares;
+		cost._notional += levelShares * priceLevel->_price;
+		cost._lastPrice = priceLevel->_price;
+	}
+	return cost._shares == shares;
+}
+
+bool OrderBook::sweepCost(int side, uint64_t shares, SweepCost &cost)
+{
+	return side ? sweepCost<1>(shares, cost) : sweepCost<0>(shares, cost);
+}
+
+template <int SIDE>
+bool OrderBook::newOrder(unsigned price, BookOrder *order)
+{
+	typedef SideTraits<SIDE> Side;
+	const int otherSide = Side::OtherSide;
 
 	if (! _tradingMask)
 	{
 		// check for cross
-		int otherSide = (side + 1) & 1;
-		if (!inside(_price[otherSide], price))
+		if (!Side::inside(_price[otherSide], price))
 		{
+			StageTimer stageTimer(*_stats, SimulatorStats::Stage::Cross);
+			uint64_t executions = _stats->counter(SimulatorStats::Counter::Executions);
+			unsigned levelCnt(0);
 			bool filled(false);
 			Intrusive::LinkedList &levelList = _priceLevels[otherSide];
 			for (Intrusive::LinkedListObject *obj = levelList.begin(); ! filled && obj != levelList.end(); obj = levelList.begin())
 			{
 				PriceLevel *priceLevel = static_cast<PriceLevel*>(obj);
-				if (inside(priceLevel->_price, price)) break;
-				filled = priceLevel->execute(side, order);
+				if (Side::inside(priceLevel->_price, price)) break;
+				++levelCnt;
+				filled = priceLevel->execute<SIDE>(order);
 				if (priceLevel->_orderCnt) break;
-				priceLevel->unlink();
-				_exchange->freePriceLevel(priceLevel);
+				freePriceLevel<otherSide>(priceLevel);
 			}
-			Intrusive::LinkedListObject *obj = levelList.begin();
-			if (obj != levelList.end()) _price[otherSide] = static_cast<PriceLevel*>(obj)->_price;
-			else _price[otherSide] = otherSide ? -1 : 0;
+			nextTopOfBook<otherSide>();
+			_stats->record(SimulatorStats::Stage::CrossLevels, levelCnt);
+			_stats->record(SimulatorStats::Stage::CrossExecutions, _stats->counter(SimulatorStats::Counter::Executions) - executions);
 			if (filled) return true;
 		}
 	}
 
 	// find price level
 	PriceLevel *priceLevel(0);
-	Intrusive::LinkedList &levelList = _priceLevels[side];
+	Intrusive::LinkedList &levelList = _priceLevels[SIDE];
+	PriceLadder &ladder = _ladder[SIDE];
+	int slot;
+	if (ladder.enabled() && (slot = ladder.slot(price)) >= 0)
+	{
+		if ((priceLevel = ladder.level(slot)))
+		{
+			priceLevel->addBookOrder(order);
+			return false;
+		}
+
+		// new level: link after the closest level inside of it
+		bool topOfBook = levelList.empty() || Side::inside(price, _price[SIDE]);
+		int topSlot = topOfBook ? -1 : ladder.slot(_price[SIDE]);
+		if (topOfBook || topSlot >= 0)
+		{
+			priceLevel = _priceLevelAllocator->allocate();
+			_stats->count(SimulatorStats::Counter::PriceLevelAllocations);
+			priceLevel->initialize(this, SIDE, price);
+			PriceLevel *insideLevel = topOfBook ? 0 : ladder.inside<SIDE>(slot, topSlot);
+			if (insideLevel) insideLevel->linkAfter(priceLevel);
+			else levelList.push_front(priceLevel);
+			priceLevel->addBookOrder(order);
+			ladder.set(slot, priceLevel);
+			if (topOfBook)
+			{
+				_price[SIDE] = price;
+				_topOfBookFlag = true;
+			}
+			return false;
+		}
+	}
+
 	Intrusive::LinkedListObject *obj = levelList.begin();
 	for (; obj != levelList.end(); obj = obj->next())
 	{
 		priceLevel = static_cast<PriceLevel*>(obj);
-		if (!inside(priceLevel->_price, price))
+		if (!Side::inside(priceLevel->_price, price))
 		{
 			if (priceLevel->_price == price)
 			{
@@ -122,44 +541,58 @@ bool OrderBook::newOrder(int side, unsigned price, BookOrder *order)
 	}
 	if (obj)
 	{
-		priceLevel = _exchange->allocatePriceLevel();
-		priceLevel->initialize(this, price);
+		priceLevel = _priceLevelAllocator->allocate();
+		_stats->count(SimulatorStats::Counter::PriceLevelAllocations);
+		priceLevel->initialize(this, SIDE, price);
 		priceLevel->addBookOrder(order);
 		obj->linkBefore(priceLevel);
+		if (ladder.enabled() && (slot = ladder.slot(price)) >= 0) ladder.set(slot, priceLevel);
 	}
 
 	if (priceLevel == levelList.begin())
 	{
-		_price[side] = priceLevel->_price;
+		setTopOfBook<SIDE>();
 	}
 
 	return false;
 }
 
-void OrderBook::cancelRequest(int side, BookOrder *referenceOrder)
+bool OrderBook::newOrder(int side, unsigned price, BookOrder *order)
+{
+	return side ? newOrder<1>(price, order) : newOrder<0>(price, order);
+}
+
+template <int SIDE>
+void OrderBook::cancelRequest(BookOrder *referenceOrder)
 {
 	PriceLevel *priceLevel = referenceOrder->_priceLevel;
-	Intrusive::LinkedList &levelList = _priceLevels[side];
+	Intrusive::LinkedList &levelList = _priceLevels[SIDE];
 	bool topOfBook = priceLevel == levelList.begin();
 	priceLevel->removeBookOrder(referenceOrder);
 	if (! priceLevel->_orderCnt)
 	{
-		priceLevel->unlink();
-		_exchange->freePriceLevel(priceLevel);
+		freePriceLevel<SIDE>(priceLevel);
 	}
 
 	if (topOfBook)
 	{
-		Intrusive::LinkedListObject *obj = levelList.begin();
-		if (obj != levelList.end()) _price[side] = static_cast<PriceLevel*>(obj)->_price;
-		else _price[side] = side ? -1 : 0;
+		nextTopOfBook<SIDE>();
 	}
 }
 
-bool OrderBook::replaceRequest(int side, unsigned price, BookOrder *order, BookOrder *referenceOrder)
+void OrderBook::cancelRequest(int side, BookOrder *referenceOrder)
+{
+	if (side) cancelRequest<1>(referenceOrder);
+	else cancelRequest<0>(referenceOrder);
+}
+
+template <int SIDE>
+bool OrderBook::replaceRequest(unsigned price, BookOrder *order, BookOrder *referenceOrder)
 {
 	bool filled;
 	PriceLevel *priceLevel = referenceOrder->_priceLevel;
+	// a quote order simulated orders took completely has already left the book
+	if (!priceLevel) return newOrder<SIDE>(price, order);
 	if (priceLevel->_price == price)
 	{
 		priceLevel->removeBookOrder(referenceOrder);
@@ -168,17 +601,169 @@ bool OrderBook::replaceRequest(int side, unsigned price, BookOrder *order, BookO
 	}
 	else
 	{
-		cancelRequest(side, referenceOrder);
-		filled = newOrder(side, price, order);
+		cancelRequest<SIDE>(referenceOrder);
+		filled = newOrder<SIDE>(price, order);
 	}
 	return filled;
 }
 
+bool OrderBook::replaceRequest(int side, unsigned price, BookOrder *order, BookOrder *referenceOrder)
+{
+	return side ? replaceRequest<1>(price, order, referenceOrder) : replaceRequest<0>(price, order, referenceOrder);
+}
+
+bool OrderBook::quoteOnly()
+{
+	for (int side = 0; side < 2; ++side)
+	{
+		Intrusive::LinkedList &levelList = _priceLevels[side];
+		if (levelList.empty()) continue;
+		PriceLevel *priceLevel = static_cast<PriceLevel*>(levelList.begin());
+		if (priceLevel->next() != levelList.end() || priceLevel->_orderCnt != 1 || !_quoteOrders[side] || _quoteOrders[side]->_priceLevel != priceLevel) return false;
+	}
+	return true;
+}
+
+void OrderBook::setQuote(const unsigned price[2], const unsigned size[2], const timespec &ts)
+{
+	if (_price[0] != price[0] || _price[1] != price[1] || _quoteSize[0] != size[0] || _quoteSize[1] != size[1]) _topOfBookFlag = true;
+	_price[0] = price[0];
+	_price[1] = price[1];
+	_quoteSize[0] = size[0];
+	_quoteSize[1] = size[1];
+	_quoteTime = ts;
+}
+
+void OrderBook::setTopOfBookOnly()
+{
+	unsigned price[2] = { _price[0], _price[1] };
+	for (int side = 0; side < 2; ++side)
+	{
+		BookOrder *quoteOrder = _quoteOrders[side];
+		if (quoteOrder)
+		{
+			_quoteSize[side] = quoteOrder->_shares;
+			_quoteTime = quoteOrder->_receivedTime;
+			if (quoteOrder->_priceLevel) cancelRequest(side, quoteOrder);
+			freeBookOrder(quoteOrder);
+			_quoteOrders[side] = 0;
+		}
+	}
+	_price[0] = price[0];
+	_price[1] = price[1];
+	_topOfBookOnly = true;
+}
+
+void OrderBook::promote()
+{
+	_topOfBookOnly = false;
+	unsigned price[2] = { _price[0], _price[1] };
+	_price[0] = SideTraits<0>::EmptyPrice;
+	_price[1] = SideTraits<1>::EmptyPrice;
+	if (price[0] == SideTraits<0>::EmptyPrice || price[1] == SideTraits<1>::EmptyPrice) return;
+
+	for (int side = 0; side < 2; ++side)
+	{
+		BookOrder *quoteOrder = allocateBookOrder();
+		quoteOrder->initialize(0, _quoteSize[side], _quoteTime);
+		newOrder(side, price[side], quoteOrder);
+		_quoteOrders[side] = quoteOrder;
+	}
+}
+
+template <int SIDE>
+void OrderBook::trade(unsigned price, unsigned shares, int tradeFillRule)
+{
+	// levels from the top of book down to the trade price
+	typedef SideTraits<SIDE> Side;
+	Intrusive::LinkedList &levelList = _priceLevels[SIDE];
+	bool topOfBook(false);
+	for (Intrusive::LinkedListObject *obj = levelList.begin(); shares && obj != levelList.end();)
+	{
+		PriceLevel *priceLevel = static_cast<PriceLevel*>(obj);
+		if (Side::inside(price, priceLevel->_price)) break;
+		bool atPrice = priceLevel->_price == price;
+		if (atPrice && tradeFillRule == TradeFillRule::ThroughOnly) break;
+		obj = obj->next();
+
+		if (!priceLevel->_simulatedCnt) continue;
+		shares = priceLevel->trade<SIDE>(shares, atPrice && tradeFillRule == TradeFillRule::QueuePosition, priceLevel->_orders.end());
+		if (!priceLevel->_orderCnt)
+		{
+			topOfBook |= priceLevel == levelList.begin();
+			freePriceLevel<SIDE>(priceLevel);
+		}
+	}
+	if (topOfBook) nextTopOfBook<SIDE>();
+}
+
+void OrderBook::trade(unsigned price, unsigned shares, int tradeFillRule)
+{
+	trade<0>(price, shares, tradeFillRule);
+	trade<1>(price, shares, tradeFillRule);
+}
+
+template <int SIDE>
+void OrderBook::fillAhead(BookOrder *marketOrder)
+{
+	// an execution at the order's level passed every level inside of it and the orders queued ahead of it
+	PriceLevel *priceLevel = marketOrder->_priceLevel;
+	trade<SIDE>(priceLevel->_price, ~0U, TradeFillRule::ThroughOnly);
+	priceLevel->trade<SIDE>(~0U, false, marketOrder);
+}
+
+void OrderBook::setMarketShares(BookOrder *marketOrder, unsigned shares)
+{
+	// the book never shows more of the order than the feed
+	marketOrder->_marketShares = shares;
+	PriceLevel *priceLevel = marketOrder->_priceLevel;
+	if (!priceLevel || marketOrder->_shares <= shares) return;
+	if (shares)
+	{
+		priceLevel->_shares -= marketOrder->_shares - shares;
+		marketOrder->_shares = shares;
+		levelChanged(priceLevel);
+	}
+	else cancelRequest(priceLevel->_side, marketOrder);
+}
+
+void OrderBook::modifyMarketOrder(int side, unsigned price, unsigned shares, BookOrder *marketOrder)
+{
+	PriceLevel *priceLevel = marketOrder->_priceLevel;
+	if (priceLevel && priceLevel->_price == price && shares <= marketOrder->_marketShares)
+	{
+		setMarketShares(marketOrder, shares);
+		return;
+	}
+
+	if (priceLevel) cancelRequest(priceLevel->_side, marketOrder);
+	marketOrder->_shares = marketOrder->_marketShares = shares;
+	if (shares) newOrder(side, price, marketOrder);
+}
+
+bool OrderBook::executeMarketOrder(BookOrder *marketOrder, unsigned shares)
+{
+	PriceLevel *priceLevel = marketOrder->_priceLevel;
+	if (priceLevel)
+	{
+		if (priceLevel->_side) fillAhead<1>(marketOrder);
+		else fillAhead<0>(marketOrder);
+	}
+	setMarketShares(marketOrder, shares < marketOrder->_marketShares ? marketOrder->_marketShares - shares : 0);
+	return !marketOrder->_marketShares;
+}
+
+void OrderBook::deleteMarketOrder(BookOrder *marketOrder)
+{
+	PriceLevel *priceLevel = marketOrder->_priceLevel;
+	if (priceLevel) cancelRequest(priceLevel->_side, marketOrder);
+}
+
 void OrderBook::display()
 {
 	Intrusive::LinkedList &buyLevels = _priceLevels[0];
 	Intrusive::LinkedList &sellLevels = _priceLevels[1];
-	printf("%s %u %u\n", _symbol, _price[0], _price[1]);
+	printf("%s %u %u\n", _exchange->symbols().symbol(_symbolId), _price[0], _price[1]);
 	for (Intrusive::LinkedListObject *obj = sellLevels.rbegin(); obj != sellLevels.end(); obj = obj->prev())
 	{
 		PriceLevel *priceLevel = static_cast<PriceLevel*>(obj);
@@ -2,8 +2,14 @@
 
 #include "IntrusiveHashTable.h"
 #include "IntrusiveLinkedList.h"
+#include "IntrusiveObjectPool.h"
+#include "OccupancyBitmap.h"
+#include "SimulatorStats.h"
+#include "CumulativeDepth.h"
+#include "SymbolRegistry.h"
 
 #include <time.h>
+#include <vector>
 
 /*
 ** OrderBook
@@ -15,6 +21,32 @@ struct BookOrder;
 class PriceLevel;
 class OrderBook;
 class ExchangeSimulator;
+struct DepthCallback;
+
+/*
+** SideTraits
+** - compile time side constants so each side gets its own matching path
+*/
+template <int SIDE>
+struct SideTraits;
+
+template <>
+struct SideTraits<0>
+{
+	static constexpr int OtherSide = 1;
+	// price of an empty side
+	static constexpr unsigned EmptyPrice = 0;
+	// l is a better price than r
+	static constexpr bool inside(unsigned l, unsigned r) { return l > r; }
+};
+
+template <>
+struct SideTraits<1>
+{
+	static constexpr int OtherSide = 0;
+	static constexpr unsigned EmptyPrice = ~0U;
+	static constexpr bool inside(unsigned l, unsigned r) { return l < r; }
+};
 
 struct BookOrder : public Intrusive::LinkedListObject, public Intrusive::HashTableObject
 {
@@ -22,32 +54,175 @@ struct BookOrder : public Intrusive::LinkedListObject, public Intrusive::HashTab
 	PriceLevel *_priceLevel;
 	uint64_t _orderId;
 	unsigned _shares;
+	// shares the order feed shows for a market order, _shares is less once simulated orders took some
+	unsigned _marketShares;
+	// book of a market order, it stays known to the checkpoint after the order left the book
+	SymbolId _symbolId;
 
 	Order *_order;
 	timespec _receivedTime;
 
-	BookOrder(): _priceLevel(0), _orderId(0), _shares(0), _order(0) {}
+	BookOrder(): _priceLevel(0), _orderId(0), _shares(0), _marketShares(0), _symbolId(SymbolRegistry::InvalidSymbolId), _order(0) {}
+	// pending order arrival time in nanoseconds
+	uint64_t wheelTime() const { return static_cast<uint64_t>(_receivedTime.tv_sec) * 1000000000 + _receivedTime.tv_nsec; }
 	void initialize(uint64_t orderId, unsigned shares, const timespec &ts);
 	void initialize(uint64_t orderId, unsigned shares, Order *order, const timespec &ts);
 };
 
+/*
+** TradeFillRule
+** - how a trade print fills simulated orders at the trade price, orders through the price always fill
+*/
+struct TradeFillRule
+{
+	enum
+	{
+		// no fills at the trade price
+		ThroughOnly = 0,
+		// market orders ahead in the queue take the print first
+		QueuePosition = 1,
+		// simulated orders at the trade price take the print first
+		Optimistic = 2
+	};
+};
+
+/*
+** DepthDelta
+** - new state of a price level, zero shares when the level is removed
+*/
+struct DepthDelta
+{
+	int _side;
+	unsigned _price;
+	unsigned _shares;
+	unsigned _orderCnt;
+};
+
+/*
+** SweepCost
+** - shares a sweep of the book can take, their notional and the last price reached
+*/
+struct SweepCost
+{
+	uint64_t _shares;
+	uint64_t _notional;
+	unsigned _lastPrice;
+};
+
+/*
+** BookMemory
+** - memory held by a book's arena and how much of it is in use
+*/
+struct BookMemory
+{
+	size_t _bytes;
+	size_t _blockCnt;
+	size_t _priceLevelCnt;
+	size_t _priceLevelCapacity;
+	size_t _bookOrderCnt;
+	size_t _bookOrderCapacity;
+
+	// share of the arena's objects that are free
+	double fragmentation() const
+	{
+		size_t capacity = _priceLevelCapacity + _bookOrderCapacity;
+		return capacity ? 1.0 - static_cast<double>(_priceLevelCnt + _bookOrderCnt) / capacity : 0.0;
+	}
+};
+
 class PriceLevel : public Intrusive::LinkedListObject
 {
 protected:
 	friend class OrderBook;
+	friend class PriceLadder;
 	OrderBook *_orderBook;
+	int _side;
 	unsigned _price;
 	unsigned _shares;
 	unsigned _orderCnt;
+	// simulated orders at this level, trades skip levels without them
+	unsigned _simulatedCnt;
+	// index of this level's depth delta in the current batch, -1 if unchanged
+	int _deltaIdx;
+	// ladder slot, -1 if not in the ladder, and the shares counted in its cumulative depth
+	int _slot;
+	unsigned _depthShares;
 	Intrusive::LinkedList _orders;
 public:
-	PriceLevel(): _orderBook(0), _price(0), _shares(0), _orderCnt(0) {}
-	void initialize(OrderBook *orderBook, unsigned price);
+	PriceLevel(): _orderBook(0), _side(0), _price(0), _shares(0), _orderCnt(0), _simulatedCnt(0), _deltaIdx(-1), _slot(-1), _depthShares(0) {}
+	void initialize(OrderBook *orderBook, int side, unsigned price);
+	int side() const { return _side; }
 	unsigned price() { return _price; }
+	unsigned shares() const { return _shares; }
+	unsigned orderCnt() const { return _orderCnt; }
 	OrderBook* orderBook() const { return _orderBook; }
-	void addBookOrder(BookOrder *order) { _shares += order->_shares; ++_orderCnt; _orders.push_back(order); order->_priceLevel = this; }
-	void removeBookOrder(BookOrder *order) { _shares -= order->_shares; --_orderCnt; order->unlink(); order->_priceLevel = 0; }
-	bool execute(int side, BookOrder *order);
+	// orders in queue order
+	Intrusive::LinkedList &orders() { return _orders; }
+	inline void addBookOrder(BookOrder *order);
+	inline void removeBookOrder(BookOrder *order);
+	// execute an order from SIDE against the orders at this level
+	template <int SIDE> bool execute(BookOrder *order);
+	// fill simulated orders of SIDE queued before end from a print of shares, returns the shares left
+	template <int SIDE> unsigned trade(unsigned shares, bool queuePosition, Intrusive::LinkedListObject *end);
+};
+
+/*
+** PriceLadder
+** - price levels for one side indexed directly by tick over a window around the top of book
+** - the window recenters when the top of book leaves it
+** - prices outside the window fall back to the price level list
+** - prices are expected to be multiples of the tick size
+** - an occupancy bitmap finds neighbouring levels without walking the list
+** - cumulative depth from the inside of the window answers depth and sweep queries in O(log n)
+*/
+class PriceLadder
+{
+protected:
+	PriceLevel **_levels;
+	OccupancyBitmap _occupied;
+	CumulativeDepth _depth;
+	int _side;
+	unsigned _size;
+	unsigned _tickSize;
+	unsigned _base;
+public:
+	PriceLadder(): _levels(0), _side(0), _size(0), _tickSize(1), _base(0) {}
+	void initialize(int side, unsigned size, unsigned tickSize);
+	bool enabled() const { return _size != 0; }
+	unsigned size() const { return _size; }
+
+	// slot for price or -1 if the price is outside the window
+	int slot(unsigned price) const;
+	unsigned price(int slot) const { return _base + slot * _tickSize; }
+	PriceLevel *level(int slot) const { return _levels[slot]; }
+	void set(int slot, PriceLevel *priceLevel);
+	void remove(PriceLevel *priceLevel);
+	// apply a change in a level's shares to the cumulative depth
+	void update(PriceLevel *priceLevel);
+	// closest level inside of slot up to the top of book slot
+	template <int SIDE> PriceLevel *inside(int slot, int topSlot) const;
+	// occupied slot closest to slot at or inside of it, -1 if none
+	template <int SIDE> int atOrInside(int slot) const;
+	// occupied slot closest to slot at or outside of it, -1 if none
+	template <int SIDE> int atOrOutside(int slot) const;
+	// most inside occupied slot, -1 if none
+	template <int SIDE> int top() const { return SIDE ? _occupied.next(0) : _occupied.prev(_size - 1); }
+	// most outside occupied slot, -1 if none
+	template <int SIDE> int bottom() const { return SIDE ? _occupied.prev(_size - 1) : _occupied.next(0); }
+	// price is past the outside edge of the window
+	template <int SIDE> bool outside(unsigned price) const { return SIDE ? price > _base && price - _base >= _size * _tickSize : price < _base; }
+	// depth index counts slots from the inside edge of the window, the mapping is its own inverse
+	unsigned depthIndex(int slot) const { return _side ? slot : _size - 1 - slot; }
+	const CumulativeDepth &depth() const { return _depth; }
+	// occupied slots between two slots
+	unsigned count(int first, int last) const { return first < last ? _occupied.count(first, last) : _occupied.count(last, first); }
+	// move the window so price is near its inside edge and reload it from the price level list
+	template <int SIDE> void recenter(unsigned price, Intrusive::LinkedList &levelList);
+
+	~PriceLadder() { delete[] _levels; }
+private:
+	PriceLadder(const PriceLadder&) = delete;
+	PriceLadder& operator = (const PriceLadder&) = delete;
 };
 
 class OrderBook : public Intrusive::HashTableObject
@@ -55,29 +230,128 @@ class OrderBook : public Intrusive::HashTableObject
 protected:
 	friend class ExchangeSimulator;
 	ExchangeSimulator *_exchange;
-	char _symbol[32];
+	SymbolId _symbolId;
 	unsigned _price[2];
 	unsigned _tradingMask;
 	Intrusive::LinkedList _priceLevels[2];
+	PriceLadder _ladder[2];
 
 	// identify that the top of book has changed
 	bool _topOfBookFlag;
 
+	// conflated level changes since the last publishDepth
+	bool _depthTracking;
+	std::vector<DepthDelta> _depthDeltas;
+	std::vector<PriceLevel*> _depthLevels;
+	// deltas by side and price, open addressing at most half full, slots of earlier batches are stale by generation
+	struct DepthDeltaSlot
+	{
+		unsigned _generation;
+		int _deltaIdx;
+	};
+	std::vector<DepthDeltaSlot> _depthDeltaSlots;
+	unsigned _depthGeneration;
+
 	// quote feed - orderId = 0
 	BookOrder *_quoteOrders[2];
+
+	// top of book only - the last quote is kept without price levels or book orders
+	bool _topOfBookOnly;
+	unsigned _quoteSize[2];
+	timespec _quoteTime;
+
+	// levels and orders come from the book's own pools in arena mode and the exchange pools otherwise
+	Intrusive::LinkedObjectPool<PriceLevel> _priceLevelPool;
+	Intrusive::LinkedObjectPool<BookOrder> _bookOrderPool;
+	Intrusive::LinkedObjectPool<PriceLevel> *_priceLevelAllocator;
+	Intrusive::LinkedObjectPool<BookOrder> *_bookOrderAllocator;
+
+	// the exchange's stats
+	SimulatorStats *_stats;
+
+	friend class PriceLevel;
+	void levelChanged(PriceLevel *priceLevel);
+	void addDepthDelta(PriceLevel *priceLevel);
+	DepthDeltaSlot &depthDeltaSlot(int side, unsigned price);
+	void resizeDepthDeltaSlots(size_t depthDeltaCnt);
+	template <int SIDE> void freePriceLevel(PriceLevel *priceLevel);
+
+	template <int SIDE> void setTopOfBook();
+	template <int SIDE> void nextTopOfBook();
+	template <int SIDE> PriceLevel *levelAtOrInside(unsigned price);
+	template <int SIDE> Intrusive::LinkedListObject *outsideLadder();
+	template <int SIDE> uint64_t sharesAtOrInside(unsigned price);
+	template <int SIDE> bool sweepCost(uint64_t shares, SweepCost &cost);
+	template <int SIDE> bool newOrder(unsigned price, BookOrder *order);
+	template <int SIDE> bool replaceRequest(unsigned price, BookOrder *order, BookOrder *referenceOrder);
+	template <int SIDE> void cancelRequest(BookOrder *referenceOrder);
+	template <int SIDE> void trade(unsigned price, unsigned shares, int tradeFillRule);
+	template <int SIDE> void fillAhead(BookOrder *marketOrder);
+	void setMarketShares(BookOrder *marketOrder, unsigned shares);
 public:
-	OrderBook() : _exchange(0), _tradingMask(0), _topOfBookFlag(false) { _price[0] = 0;  _price[1] = -1; _quoteOrders[0] = _quoteOrders[1] = 0; }
-	void initialize(ExchangeSimulator *exchange, const char *symbol);
+	OrderBook() : _exchange(0), _symbolId(SymbolRegistry::InvalidSymbolId), _tradingMask(0), _topOfBookFlag(false), _depthTracking(false), _depthGeneration(1), _topOfBookOnly(false), _priceLevelAllocator(&_priceLevelPool), _bookOrderAllocator(&_bookOrderPool), _stats(0)
+	{
+		_price[0] = 0;  _price[1] = -1; _quoteOrders[0] = _quoteOrders[1] = 0; _quoteSize[0] = _quoteSize[1] = 0; _quoteTime.tv_sec = _quoteTime.tv_nsec = 0;
+	}
+	void initialize(ExchangeSimulator *exchange, SymbolId symbolId);
+	// allocate from shared pools, set before the first allocation
+	void setAllocators(Intrusive::LinkedObjectPool<PriceLevel> *priceLevelAllocator, Intrusive::LinkedObjectPool<BookOrder> *bookOrderAllocator);
+	// allocate from the book's own pools growing by the given counts, set before the first allocation
+	void setArena(size_t priceLevelCnt, size_t bookOrderCnt);
+	BookOrder *allocateBookOrder() { _stats->count(SimulatorStats::Counter::BookOrderAllocations); return _bookOrderAllocator->allocate(); }
+	void freeBookOrder(BookOrder *bookOrder) { _bookOrderAllocator->free(bookOrder); }
+	// footprint of the book's own pools
+	void memory(BookMemory &bookMemory) const;
+	// allocate the first arena blocks and room for depthDeltaCnt level changes per publishDepth before the first order
+	void reserve(size_t depthDeltaCnt = 16);
+	// index price levels by tick: size slots per side, 0 uses only the price level lists
+	void setPriceLadder(unsigned size, unsigned tickSize);
+	// record level changes for publishDepth
+	void setDepthTracking(bool depthTracking) { _depthTracking = depthTracking; }
 	ExchangeSimulator *exchange() { return _exchange; }
-	const char *symbol() const { return _symbol; }
+	SymbolId symbolId() const { return _symbolId; }
 	unsigned bid() const { return _price[0]; }
 	unsigned ask() const { return _price[1]; }
 
+	// closest level at price or inside of it
+	PriceLevel *levelAtOrInside(int side, unsigned price);
+	// number of levels with prices between two prices inclusive
+	unsigned levelCount(int side, unsigned price1, unsigned price2);
+	// shares at price and inside of it, the queue ahead of an order joining at price
+	uint64_t sharesAtOrInside(int side, unsigned price);
+	// cost of taking shares from the levels of side, false if the side holds fewer shares
+	bool sweepCost(int side, uint64_t shares, SweepCost &cost);
+
 	bool newOrder(int side, unsigned price, BookOrder *order);
 	bool replaceRequest(int side, unsigned price, BookOrder *order, BookOrder *referenceOrder);
 	void cancelRequest(int side, BookOrder *referenceOrder);
 
 	void execute(int side, unsigned price, unsigned shares, BookOrder *order);
+	// fill simulated orders at or through a trade print on both sides
+	void trade(unsigned price, unsigned shares, int tradeFillRule);
+
+	// order feed - market orders join the price level queues with newOrder
+	// a size decrease at the same price keeps the queue position, any other change loses it
+	void modifyMarketOrder(int side, unsigned price, unsigned shares, BookOrder *marketOrder);
+	// fill the simulated orders the aggressor reached first, true once the feed shows no shares left
+	bool executeMarketOrder(BookOrder *marketOrder, unsigned shares);
+	void deleteMarketOrder(BookOrder *marketOrder);
+
+	bool topOfBookOnly() const { return _topOfBookOnly; }
+	// size of the last quote while top of book only
+	unsigned quoteSize(int side) const { return _quoteSize[side]; }
+	// the book holds no orders other than the quote orders
+	bool quoteOnly();
+	// update the quote of a top of book only book
+	void setQuote(const unsigned price[2], const unsigned size[2], const timespec &ts);
+	// release the quote orders and levels and keep only the quote, the level removals are the last depth deltas until promote
+	void setTopOfBookOnly();
+	// rebuild the quote orders from the quote before simulated orders enter the book
+	void promote();
+
+	bool topOfBookChanged() const { return _topOfBookFlag; }
+	// send the level changes since the last call and clear them
+	void publishDepth(DepthCallback *callback);
 
 	void display();
 };
@@ -87,7 +361,7 @@ void BookOrder::initialize(uint64_t orderId, unsigned shares, const timespec &ts
 {
 	_priceLevel = 0;
 	_orderId = orderId;
-	_shares = shares;
+	_shares = _marketShares = shares;
 	_order = 0;
 	_receivedTime = ts;
 }
@@ -103,11 +377,113 @@ void BookOrder::initialize(uint64_t orderId, unsigned shares, Order *order, cons
 }
 
 inline
-void PriceLevel::initialize(OrderBook *orderBook, unsigned price)
+void PriceLevel::initialize(OrderBook *orderBook, int side, unsigned price)
 {
 	_orderBook = orderBook;
+	_side = side;
 	_price = price;
-	_shares = _orderCnt = 0;
+	_shares = _orderCnt = _simulatedCnt = 0;
+	_deltaIdx = -1;
+	_slot = -1;
+	_depthShares = 0;
+}
+
+inline
+void PriceLevel::addBookOrder(BookOrder *order)
+{
+	_shares += order->_shares;
+	++_orderCnt;
+	if (order->_order) ++_simulatedCnt;
+	_orders.push_back(order);
+	order->_priceLevel = this;
+	_orderBook->levelChanged(this);
+}
+
+inline
+void PriceLevel::removeBookOrder(BookOrder *order)
+{
+	_shares -= order->_shares;
+	--_orderCnt;
+	if (order->_order) --_simulatedCnt;
+	order->unlink();
+	order->_priceLevel = 0;
+	_orderBook->levelChanged(this);
+}
+
+inline
+void OrderBook::levelChanged(PriceLevel *priceLevel)
+{
+	if (priceLevel->_price == _price[priceLevel->_side]) _topOfBookFlag = true;
+	if (_depthTracking && priceLevel->_deltaIdx < 0) addDepthDelta(priceLevel);
+	if (priceLevel->_slot >= 0) _ladder[priceLevel->_side].update(priceLevel);
+}
+
+inline
+int PriceLadder::slot(unsigned price) const
+{
+	unsigned offset = price - _base;
+	unsigned index = offset / _tickSize;
+	return index < _size && index * _tickSize == offset ? static_cast<int>(index) : -1;
+}
+
+inline
+void PriceLadder::set(int slot, PriceLevel *priceLevel)
+{
+	_levels[slot] = priceLevel;
+	_occupied.set(slot);
+	priceLevel->_slot = slot;
+	priceLevel->_depthShares = priceLevel->_shares;
+	_depth.add(depthIndex(slot), priceLevel->_shares, static_cast<uint64_t>(priceLevel->_shares) * priceLevel->_price);
+}
+
+inline
+void PriceLadder::remove(PriceLevel *priceLevel)
+{
+	int s = priceLevel->_slot;
+	if (s >= 0)
+	{
+		_levels[s] = 0;
+		_occupied.reset(s);
+		uint64_t shares = 0 - static_cast<uint64_t>(priceLevel->_depthShares);
+		_depth.add(depthIndex(s), shares, shares * priceLevel->_price);
+		priceLevel->_slot = -1;
+		priceLevel->_depthShares = 0;
+	}
+}
+
+inline
+void PriceLadder::update(PriceLevel *priceLevel)
+{
+	// wraps when the level shrinks
+	uint64_t shares = static_cast<uint64_t>(priceLevel->_shares) - priceLevel->_depthShares;
+	if (shares)
+	{
+		_depth.add(depthIndex(priceLevel->_slot), shares, shares * priceLevel->_price);
+		priceLevel->_depthShares = priceLevel->_shares;
+	}
+}
+
+template <int SIDE>
+int PriceLadder::atOrInside(int slot) const
+{
+	if (slot < 0) return SIDE ? OccupancyBitmap::NotFound : _occupied.next(0);
+	return SIDE ? _occupied.prev(slot) : _occupied.next(slot);
+}
+
+template <int SIDE>
+int PriceLadder::atOrOutside(int slot) const
+{
+	if (slot < 0) return SIDE ? _occupied.next(0) : OccupancyBitmap::NotFound;
+	return SIDE ? _occupied.next(slot) : _occupied.prev(slot);
+}
+
+template <int SIDE>
+PriceLevel *PriceLadder::inside(int slot, int topSlot) const
+{
+	// bids are inside at higher prices, asks at lower prices
+	if (slot == topSlot) return 0;
+	int s = atOrInside<SIDE>(SIDE ? slot - 1 : slot + 1);
+	return s >= 0 && (SIDE ? s >= topSlot : s <= topSlot) ? _levels[s] : 0;
 }
 
 
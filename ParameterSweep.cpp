@@ -0,0 +1,142 @@
+#include "ParameterSweep.h"
+
+void TickBuffer::add(const Tick &tick)
+{
+	TickRecord tickRecord;
+	switch (tick._type)
+	{
+	case Tick::Quote:
+		tickRecord._quote = static_cast<const Quote&>(tick);
+		break;
+	case Tick::Trade:
+		tickRecord._trade = static_cast<const Trade&>(tick);
+		break;
+	case Tick::MarketOrder:
+		tickRecord._marketOrder = static_cast<const MarketOrder&>(tick);
+		break;
+	default:
+		printf("%s %s %d: unhandled tick type: %d\n", __FILE__, __FUNCTION__, __LINE__, tick._type);
+		return;
+	}
+	_records.push_back(tickRecord);
+}
+
+const Tick *const *TickBuffer::ticks()
+{
+	// records move when the buffer grows
+	if (_ticks.size() != _records.size() || (!_records.empty() && _ticks.front() != &_records.front()._tick))
+	{
+		_ticks.resize(_records.size());
+		for (size_t idx = 0; idx < _records.size(); ++idx)
+			_ticks[idx] = &_records[idx]._tick;
+	}
+	return _ticks.data();
+}
+
+SweepRun::SweepRun(uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, SymbolRegistry *symbolRegistry):
+	_exchange(delayMicroseconds, bookCnt, orderCnt, &_timeManager, symbolRegistry),
+	_tickIdx(0),
+	_started(false)
+{
+}
+
+ParameterSweep::ParameterSweep(TickBuffer &tickBuffer, unsigned threadCnt, size_t blockSize):
+	_tickBuffer(tickBuffer),
+	_ticks(0),
+	_tickCnt(0),
+	_blockSize(blockSize ? blockSize : 1),
+	_nextWorker(0),
+	_runCnt(0)
+{
+	if (!threadCnt) threadCnt = 1;
+	for (unsigned workerIdx = 0; workerIdx < threadCnt; ++workerIdx)
+		_workers.push_back(new Worker);
+}
+
+ParameterSweep::~ParameterSweep()
+{
+	for (Worker *worker : _workers)
+		delete worker;
+}
+
+void ParameterSweep::add(SweepRun *sweepRun)
+{
+	Worker *worker = _workers[_nextWorker++ % _workers.size()];
+	std::lock_guard<std::mutex> lock(worker->_mutex);
+	worker->_runs.push_back(sweepRun);
+	_runCnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+SweepRun *ParameterSweep::take(unsigned workerIdx)
+{
+	// own runs from the front, the run just replayed is still in cache
+	Worker *worker = _workers[workerIdx];
+	{
+		std::lock_guard<std::mutex> lock(worker->_mutex);
+		if (!worker->_runs.empty())
+		{
+			SweepRun *sweepRun = worker->_runs.front();
+			worker->_runs.pop_front();
+			return sweepRun;
+		}
+	}
+
+	// steal from the back of the other workers
+	for (size_t idx = 1; idx < _workers.size(); ++idx)
+	{
+		Worker *victim = _workers[(workerIdx + idx) % _workers.size()];
+		std::lock_guard<std::mutex> lock(victim->_mutex);
+		if (!victim->_runs.empty())
+		{
+			SweepRun *sweepRun = victim->_runs.back();
+			victim->_runs.pop_back();
+			return sweepRun;
+		}
+	}
+	return 0;
+}
+
+void ParameterSweep::work(unsigned workerIdx)
+{
+	Worker *worker = _workers[workerIdx];
+	while (_runCnt.load(std::memory_order_acquire))
+	{
+		SweepRun *sweepRun = take(workerIdx);
+		if (!sweepRun)
+		{
+			// the remaining runs are being replayed by other workers
+			std::this_thread::yield();
+			continue;
+		}
+
+		if (!sweepRun->_started)
+		{
+			sweepRun->_started = true;
+			sweepRun->start();
+		}
+		size_t tickCnt = _tickCnt - sweepRun->_tickIdx < _blockSize ? _tickCnt - sweepRun->_tickIdx : _blockSize;
+		if (tickCnt) sweepRun->onTicks(_ticks + sweepRun->_tickIdx, tickCnt);
+		sweepRun->_tickIdx += tickCnt;
+
+		if (sweepRun->_tickIdx == _tickCnt)
+		{
+			sweepRun->finish();
+			_runCnt.fetch_sub(1, std::memory_order_release);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(worker->_mutex);
+			worker->_runs.push_front(sweepRun);
+		}
+	}
+}
+
+void ParameterSweep::run()
+{
+	_ticks = _tickBuffer.ticks();
+	_tickCnt = _tickBuffer.size();
+	for (unsigned workerIdx = 0; workerIdx < _workers.size(); ++workerIdx)
+		_workers[workerIdx]->_thread = std::thread(&ParameterSweep::work, this, workerIdx);
+	for (Worker *worker : _workers)
+		worker->_thread.join();
+}
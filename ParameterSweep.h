@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ExchangeSimulator.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+** TickBuffer
+** - ticks decoded once and replayed read only by any number of simulators
+*/
+class TickBuffer
+{
+protected:
+	union TickRecord
+	{
+		Tick _tick;
+		Quote _quote;
+		Trade _trade;
+		MarketOrder _marketOrder;
+		TickRecord() : _tick() {}
+	};
+	std::vector<TickRecord> _records;
+	std::vector<const Tick*> _ticks;
+public:
+	void reserve(size_t tickCnt) { _records.reserve(tickCnt); }
+	// ticks in time order
+	void add(const Tick &tick);
+	size_t size() const { return _records.size(); }
+	// block for ExchangeSimulator::onTicks, valid until the next add
+	const Tick *const *ticks();
+};
+
+/*
+** SweepRun
+** - one parameter set of a sweep with its own simulator and time manager
+** - derive to hook up the strategy in start and collect its results in finish
+** - a run moves between worker threads only between tick blocks
+*/
+class SweepRun
+{
+protected:
+	friend class ParameterSweep;
+	TimeManager _timeManager;
+	ExchangeSimulator _exchange;
+	size_t _tickIdx;
+	bool _started;
+public:
+	SweepRun(uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, SymbolRegistry *symbolRegistry);
+	ExchangeSimulator &exchange() { return _exchange; }
+	TimeManager &timeManager() { return _timeManager; }
+
+	// before the first tick, on the worker thread that takes the run
+	virtual void start() {}
+	// strategies that watch market data override this and pass the ticks on
+	virtual void onTicks(const Tick *const *ticks, size_t tickCnt) { _exchange.onTicks(ticks, tickCnt); }
+	// after the last tick
+	virtual void finish() {}
+	virtual ~SweepRun() {}
+private:
+	SweepRun(const SweepRun&) = delete;
+	SweepRun& operator = (const SweepRun&) = delete;
+};
+
+/*
+** ParameterSweep
+** - replays one shared tick buffer through many independent runs on a thread pool
+** - each worker keeps its own runs and takes the most recent one back after every tick block,
+**   idle workers steal the least recent run of another worker
+** - the symbol registry must not grow while the sweep runs
+*/
+class ParameterSweep
+{
+protected:
+	struct Worker
+	{
+		std::mutex _mutex;
+		std::deque<SweepRun*> _runs;
+		std::thread _thread;
+	};
+
+	TickBuffer &_tickBuffer;
+	const Tick *const *_ticks;
+	size_t _tickCnt;
+	size_t _blockSize;
+	std::vector<Worker*> _workers;
+	unsigned _nextWorker;
+	// runs not finished yet
+	std::atomic<size_t> _runCnt;
+
+	SweepRun *take(unsigned workerIdx);
+	void work(unsigned workerIdx);
+public:
+	ParameterSweep(TickBuffer &tickBuffer, unsigned threadCnt = std::thread::hardware_concurrency(), size_t blockSize = 4096);
+
+	unsigned threadCnt() const { return static_cast<unsigned>(_workers.size()); }
+	// runs stay owned by the caller and hold their results after run returns
+	void add(SweepRun *sweepRun);
+	// replay every run to the end of the tick buffer
+	void run();
+
+	~ParameterSweep();
+private:
+	ParameterSweep(const ParameterSweep&) = delete;
+	ParameterSweep& operator = (const ParameterSweep&) = delete;
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "WaitStrategy.h"
+
+/*
+** SPSCBatchQueue
+** - single producer single consumer ring with the SPSCQueue element API plus batch claim/publish and peek/release
+** - each side caches the other side's index and reloads it only when the ring looks full or empty,
+**   so the shared index lines move between cores once per batch instead of once per element
+** - indices run freely and are masked on access, all capacity slots are usable
+** - batches are contiguous and end at the end of the buffer, ask again for the part after the wrap
+*/
+template <typename T, typename WaitStrategy = YieldWait>
+class SPSCBatchQueue
+{
+private:
+	std::vector<T> m_buffer;
+	unsigned m_capacity;
+	unsigned m_mask;
+
+	// producer: published index and its copy of the consumer's index
+	alignas(64) std::atomic<unsigned> m_aWriteIdx{ 0 };
+	unsigned m_writeIdx{ 0 };
+	unsigned m_readIdxCache{ 0 };
+	// parking state the consumer writes, on a line of its own so it does not bounce the index lines
+	alignas(64) WaitStrategy m_waitStrategy;
+
+	// consumer: released index and its copy of the producer's index
+	alignas(64) std::atomic<unsigned> m_aReadIdx{ 0 };
+	unsigned m_readIdx{ 0 };
+	unsigned m_writeIdxCache{ 0 };
+public:
+	SPSCBatchQueue(unsigned capacity): m_capacity(std::pow(2, ceil(log2(capacity)))), m_mask(m_capacity - 1)
+	{
+		m_buffer.resize(m_capacity);
+	}
+
+	unsigned capacity() const { return m_capacity; }
+
+	// up to cnt free slots from the write position, cnt is set to the number claimed, nullptr if none
+	T* claim(unsigned &cnt)
+	{
+		unsigned free = m_capacity - (m_writeIdx - m_readIdxCache);
+		if (free < cnt)
+		{
+			// acquire so the consumer is done with the slots before they are overwritten
+			m_readIdxCache = m_aReadIdx.load(std::memory_order_acquire);
+			free = m_capacity - (m_writeIdx - m_readIdxCache);
+		}
+		unsigned slot = m_writeIdx & m_mask;
+		unsigned contiguous = m_capacity - slot;
+		if (cnt > free) cnt = free;
+		if (cnt > contiguous) cnt = contiguous;
+		return cnt ? &m_buffer[slot] : nullptr;
+	}
+
+	// make cnt claimed slots visible to the consumer with one release store
+	void publish(unsigned cnt)
+	{
+		m_writeIdx += cnt;
+		m_aWriteIdx.store(m_writeIdx, std::memory_order_release);
+		m_waitStrategy.notify(m_aWriteIdx);
+	}
+
+	// up to cnt published slots from the read position, cnt is set to the number available, nullptr if none
+	T* peek(unsigned &cnt)
+	{
+		unsigned available = m_writeIdxCache - m_readIdx;
+		if (available < cnt)
+		{
+			m_writeIdxCache = m_aWriteIdx.load(std::memory_order_acquire);
+			available = m_writeIdxCache - m_readIdx;
+		}
+		unsigned slot = m_readIdx & m_mask;
+		unsigned contiguous = m_capacity - slot;
+		if (cnt > available) cnt = available;
+		if (cnt > contiguous) cnt = contiguous;
+		return cnt ? &m_buffer[slot] : nullptr;
+	}
+
+	// hand cnt peeked slots back to the producer with one release store
+	void release(unsigned cnt)
+	{
+		m_readIdx += cnt;
+		m_aReadIdx.store(m_readIdx, std::memory_order_release);
+	}
+
+	// SPSCQueue compatible single element calls
+	T* back()
+	{
+		if (m_writeIdx - m_readIdxCache == m_capacity)
+		{
+			m_readIdxCache = m_aReadIdx.load(std::memory_order_acquire);
+			if (m_writeIdx - m_readIdxCache == m_capacity) return nullptr;
+		}
+		return &m_buffer[m_writeIdx & m_mask];
+	}
+
+	void push_back() { publish(1); }
+
+	T* front()
+	{
+		if (m_readIdx == m_writeIdxCache)
+		{
+			m_writeIdxCache = m_aWriteIdx.load(std::memory_order_acquire);
+			if (m_readIdx == m_writeIdxCache) return nullptr;
+		}
+		return &m_buffer[m_readIdx & m_mask];
+	}
+
+	void pop_front() { release(1); }
+
+	// front, waiting up to timeoutNanoseconds for the producer, nullptr on timeout
+	T* front_wait(uint64_t timeoutNanoseconds = ~0ULL)
+	{
+		T *t = front();
+		if (!t) m_waitStrategy.wait(m_aWriteIdx, m_readIdx, [this, &t] { return (t = front()) != nullptr; }, timeoutNanoseconds);
+		return t;
+	}
+
+	// move the next value out, waiting for the producer as long as it takes
+	void pop_wait(T& t)
+	{
+		t = std::move(*front_wait());
+		pop_front();
+	}
+};
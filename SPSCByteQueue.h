@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "WaitStrategy.h"
+
+/*
+** SPSCByteQueue
+** - single producer single consumer ring of variable length records, such as raw FIX messages
+** - a record is an 8 byte length followed by the bytes, rounded up to 8 bytes, and never wraps:
+**   a record that does not fit before the end of the buffer is written at its start behind a padding record
+**   the reader skips, so every record is read as one contiguous span
+** - the producer reserves space, writes in place and commits the length it used, the consumer reads a span
+**   in place and releases it when done, no copies and no allocation
+** - each side caches the other side's index as in SPSCBatchQueue
+** - records are at most half the capacity so one always fits once the consumer catches up, capacity is at most 2^31
+*/
+template <typename WaitStrategy = YieldWait>
+class SPSCByteQueue
+{
+private:
+	enum
+	{
+		HeaderSize = sizeof(uint64_t),
+		Align = sizeof(uint64_t)
+	};
+	static const uint64_t Padding = ~0ULL;
+
+	std::vector<uint64_t> m_buffer;
+	char *m_data;
+	unsigned m_capacity;
+	unsigned m_mask;
+
+	// producer, byte indices run freely
+	alignas(64) std::atomic<unsigned> m_aWriteIdx{ 0 };
+	unsigned m_writeIdx{ 0 };
+	unsigned m_readIdxCache{ 0 };
+	// start of the reserved record, past any padding
+	unsigned m_reserveIdx{ 0 };
+	// parking state the consumer writes, on a line of its own so it does not bounce the index lines
+	alignas(64) WaitStrategy m_waitStrategy;
+
+	// consumer
+	alignas(64) std::atomic<unsigned> m_aReadIdx{ 0 };
+	unsigned m_readIdx{ 0 };
+	unsigned m_writeIdxCache{ 0 };
+
+	static unsigned recordSize(size_t size) { return static_cast<unsigned>((HeaderSize + size + Align - 1) & ~static_cast<size_t>(Align - 1)); }
+	uint64_t& header(unsigned idx) { return *reinterpret_cast<uint64_t*>(m_data + (idx & m_mask)); }
+
+	unsigned freeBytes(unsigned needed)
+	{
+		unsigned free = m_capacity - (m_writeIdx - m_readIdxCache);
+		if (free < needed)
+		{
+			// acquire so the consumer is done with the bytes before they are overwritten
+			m_readIdxCache = m_aReadIdx.load(std::memory_order_acquire);
+			free = m_capacity - (m_writeIdx - m_readIdxCache);
+		}
+		return free;
+	}
+public:
+	SPSCByteQueue(unsigned capacity) : m_capacity(std::pow(2, ceil(log2(capacity < 4 * HeaderSize ? 4 * HeaderSize : capacity)))), m_mask(m_capacity - 1)
+	{
+		m_buffer.resize(m_capacity / sizeof(uint64_t));
+		m_data = reinterpret_cast<char*>(m_buffer.data());
+	}
+
+	unsigned capacity() const { return m_capacity; }
+	// largest record
+	size_t maxSize() const { return m_capacity / 2 - HeaderSize; }
+
+	// contiguous space for a record of up to size bytes, nullptr while the queue is too full
+	char* reserve(size_t size)
+	{
+		if (size > maxSize()) return nullptr;
+		unsigned needed = recordSize(size);
+		unsigned tail = m_capacity - (m_writeIdx & m_mask);
+		if (needed <= tail)
+		{
+			if (freeBytes(needed) < needed) return nullptr;
+			m_reserveIdx = m_writeIdx;
+		}
+		else
+		{
+			// pad out the tail and start over at the front of the buffer
+			if (freeBytes(tail + needed) < tail + needed) return nullptr;
+			header(m_writeIdx) = Padding;
+			m_reserveIdx = m_writeIdx + tail;
+		}
+		return m_data + ((m_reserveIdx + HeaderSize) & m_mask);
+	}
+
+	// publish the reserved record with the size actually written, no more than reserved
+	void commit(size_t size)
+	{
+		header(m_reserveIdx) = size;
+		m_writeIdx = m_reserveIdx + recordSize(size);
+		m_aWriteIdx.store(m_writeIdx, std::memory_order_release);
+		m_waitStrategy.notify(m_aWriteIdx);
+	}
+
+	// copy a record in, false while the queue is too full
+	bool write(const char *data, size_t size)
+	{
+		char *record = reserve(size);
+		if (!record) return false;
+		memcpy(record, data, size);
+		commit(size);
+		return true;
+	}
+
+	// the next record in place, nullptr while there is none
+	const char* read(size_t &size)
+	{
+		for (;;)
+		{
+			if (m_readIdx == m_writeIdxCache)
+			{
+				m_writeIdxCache = m_aWriteIdx.load(std::memory_order_acquire);
+				if (m_readIdx == m_writeIdxCache) return nullptr;
+			}
+			uint64_t recordHeader = header(m_readIdx);
+			if (recordHeader != Padding)
+			{
+				size = static_cast<size_t>(recordHeader);
+				return m_data + ((m_readIdx + HeaderSize) & m_mask);
+			}
+			// the producer wrapped, the next record is at the front of the buffer
+			m_readIdx += m_capacity - (m_readIdx & m_mask);
+		}
+	}
+
+	// hand the record returned by read back to the producer
+	void release()
+	{
+		m_readIdx += recordSize(static_cast<size_t>(header(m_readIdx)));
+		m_aReadIdx.store(m_readIdx, std::memory_order_release);
+	}
+
+	// read, waiting up to timeoutNanoseconds for the producer, nullptr on timeout
+	const char* read_wait(size_t &size, uint64_t timeoutNanoseconds = ~0ULL)
+	{
+		const char *data = read(size);
+		if (!data) m_waitStrategy.wait(m_aWriteIdx, m_readIdx, [this, &data, &size] { return (data = read(size)) != nullptr; }, timeoutNanoseconds);
+		return data;
+	}
+};
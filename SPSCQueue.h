@@ -3,7 +3,9 @@
 #include <cmath>
 #include <vector>
 
-template <typename T>
+#include "WaitStrategy.h"
+
+template <typename T, typename WaitStrategy = YieldWait>
 class SPSCQueue
 {
 private:
@@ -13,6 +15,8 @@ private:
 	unsigned m_writeIdx{ 0 };
 	unsigned m_nextWriteIdx{ 0 };
 	std::atomic<unsigned> m_aWriteIdx{ 0 };
+	// parking state the consumer writes, on a line of its own so it does not bounce the index lines
+	alignas(64) WaitStrategy m_waitStrategy;
 	alignas(64) std::atomic<unsigned> m_aReadIdx{ 0 };
 	unsigned m_readIdx{ 0 };
 public:
@@ -24,13 +28,15 @@ public:
 	T* back()
 	{
 		m_nextWriteIdx = (m_writeIdx + 1) & m_mask;
-		return m_nextWriteIdx != m_aReadIdx.load(std::memory_order_relaxed) ? &m_buffer[m_writeIdx] : nullptr;
+		// acquire so the consumer is done with the slot before it is overwritten
+		return m_nextWriteIdx != m_aReadIdx.load(std::memory_order_acquire) ? &m_buffer[m_writeIdx] : nullptr;
 	}
 
 	void push_back()
 	{
 		m_writeIdx = m_nextWriteIdx;
 		m_aWriteIdx.store(m_nextWriteIdx, std::memory_order_release);
+		m_waitStrategy.notify(m_aWriteIdx);
 	}
 
 	T* front()
@@ -41,6 +47,21 @@ public:
 	void pop_front()
 	{
 		m_readIdx = (m_readIdx + 1) & m_mask;
-		m_aReadIdx.store(m_readIdx, std::memory_order_relaxed);
+		m_aReadIdx.store(m_readIdx, std::memory_order_release);
+	}
+
+	// front, waiting up to timeoutNanoseconds for the producer, nullptr on timeout
+	T* front_wait(uint64_t timeoutNanoseconds = ~0ULL)
+	{
+		T *t = front();
+		if (!t) m_waitStrategy.wait(m_aWriteIdx, m_readIdx, [this, &t] { return (t = front()) != nullptr; }, timeoutNanoseconds);
+		return t;
+	}
+
+	// move the next value out, waiting for the producer as long as it takes
+	void pop_wait(T& t)
+	{
+		t = std::move(*front_wait());
+		pop_front();
 	}
 };
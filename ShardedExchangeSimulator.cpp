@@ -0,0 +1,252 @@
+#include "ShardedExchangeSimulator.h"
+
+#include "Order.h"
+
+namespace
+{
+uint64_t nanoseconds(const timespec &ts)
+{
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+} // namespace
+
+ShardedExchangeSimulator::Shard::Shard(unsigned shardIdx, uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, SymbolRegistry *symbolRegistry, unsigned queueSize):
+	_shardIdx(shardIdx),
+	_exchange(delayMicroseconds, bookCnt, orderCnt, &_timeManager, symbolRegistry),
+	_input(queueSize),
+	_output(queueSize),
+	_seq(0),
+	_watermark(0),
+	_stopped(false)
+{
+	_exchange.setExecutionReportCallback(this);
+}
+
+void ShardedExchangeSimulator::Shard::onExecution(SimulatorExecutionReport &executionReport)
+{
+	// the caller drains reports while it waits to send, so a full queue empties
+	ShardReport *shardReport;
+	while (!(shardReport = _output.back())) std::this_thread::yield();
+	shardReport->_time = nanoseconds(_timeManager.time());
+	shardReport->_seq = _seq++;
+	shardReport->_executionReport = executionReport;
+	_output.push_back();
+}
+
+void ShardedExchangeSimulator::Shard::run()
+{
+	for (;;)
+	{
+		ShardMessage *shardMessage = _input.front_wait();
+
+		uint64_t watermark(0);
+		switch (shardMessage->_type)
+		{
+		case ShardMessage::TickMessage:
+			_exchange.onTick(shardMessage->_tick);
+			watermark = nanoseconds(shardMessage->_tick._ts);
+			break;
+		case ShardMessage::OrderMessage:
+			_exchange.onOrder(shardMessage->_order);
+			break;
+		case ShardMessage::TimeMessage:
+			_timeManager.setTime(shardMessage->_ts);
+			watermark = nanoseconds(shardMessage->_ts);
+			break;
+		case ShardMessage::StopMessage:
+			_input.pop_front();
+			_stopped.store(true, std::memory_order_release);
+			return;
+		}
+		_input.pop_front();
+		if (watermark) _watermark.store(watermark, std::memory_order_release);
+	}
+}
+
+bool ShardedExchangeSimulator::ReportGreater::operator() (const ShardReport *l, const ShardReport *r) const
+{
+	if (l->_time != r->_time) return l->_time > r->_time;
+	if (l->_executionReport._symbolId != r->_executionReport._symbolId) return l->_executionReport._symbolId > r->_executionReport._symbolId;
+	return l->_seq > r->_seq;
+}
+
+ShardedExchangeSimulator::ShardedExchangeSimulator(unsigned shardCnt, uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, SymbolRegistry *symbolRegistry, unsigned queueSize):
+	_executionReportCallback(0),
+	_running(false),
+	_syncInterval(1000000),
+	_syncTime(0)
+{
+	if (!shardCnt) shardCnt = 1;
+	size_t shardBookCnt = bookCnt / shardCnt + 1;
+	size_t shardOrderCnt = orderCnt / shardCnt + 1;
+	for (unsigned shardIdx = 0; shardIdx < shardCnt; ++shardIdx)
+		_shards.push_back(new Shard(shardIdx, delayMicroseconds, shardBookCnt, shardOrderCnt, symbolRegistry, queueSize));
+}
+
+ShardedExchangeSimulator::~ShardedExchangeSimulator()
+{
+	stop();
+	for (ShardReport *shardReport : _freeReports)
+		delete shardReport;
+	for (; !_reports.empty(); _reports.pop())
+		delete _reports.top();
+	for (Shard *shard : _shards)
+		delete shard;
+}
+
+void ShardedExchangeSimulator::createOrderBooks()
+{
+	unsigned shardCnt = this->shardCnt();
+	for (Shard *shard : _shards)
+		shard->_exchange.createOrderBooks(shard->_shardIdx, shardCnt);
+}
+
+void ShardedExchangeSimulator::start()
+{
+	if (_running) return;
+	_running = true;
+	for (Shard *shard : _shards)
+		shard->_thread = std::thread(&Shard::run, shard);
+}
+
+void ShardedExchangeSimulator::stop()
+{
+	if (!_running) return;
+	for (Shard *shard : _shards)
+	{
+		message(shard)->_type = ShardMessage::StopMessage;
+		shard->_input.push_back();
+	}
+	for (Shard *shard : _shards)
+	{
+		// keep draining so a shard blocked on a full report queue can reach the stop message
+		while (!shard->_stopped.load(std::memory_order_acquire))
+		{
+			collect();
+			std::this_thread::yield();
+		}
+		shard->_thread.join();
+		shard->_stopped.store(false, std::memory_order_relaxed);
+	}
+	_running = false;
+	collect();
+	publish(~0ULL);
+}
+
+ShardedExchangeSimulator::ShardMessage *ShardedExchangeSimulator::message(Shard *shard)
+{
+	ShardMessage *shardMessage;
+	while (!(shardMessage = shard->_input.back()))
+	{
+		collect();
+		std::this_thread::yield();
+	}
+	return shardMessage;
+}
+
+void ShardedExchangeSimulator::sendTime(const timespec &ts)
+{
+	for (Shard *shard : _shards)
+	{
+		ShardMessage *shardMessage = message(shard);
+		shardMessage->_type = ShardMessage::TimeMessage;
+		shardMessage->_ts = ts;
+		shard->_input.push_back();
+	}
+}
+
+void ShardedExchangeSimulator::collect()
+{
+	for (Shard *shard : _shards)
+	{
+		for (ShardReport *shardReport = shard->_output.front(); shardReport; shardReport = shard->_output.front())
+		{
+			ShardReport *report;
+			if (_freeReports.empty()) report = new ShardReport;
+			else
+			{
+				report = _freeReports.back();
+				_freeReports.pop_back();
+			}
+			*report = *shardReport;
+			shard->_output.pop_front();
+			_reports.push(report);
+		}
+	}
+}
+
+void ShardedExchangeSimulator::publish(uint64_t limit)
+{
+	for (; !_reports.empty() && _reports.top()->_time < limit; _reports.pop())
+	{
+		ShardReport *report = _reports.top();
+		if (_executionReportCallback) _executionReportCallback->onExecution(report->_executionReport);
+		_freeReports.push_back(report);
+	}
+}
+
+void ShardedExchangeSimulator::onTick(const Tick &tick)
+{
+	Shard *tickShard = shard(tick._symbolId);
+	ShardMessage *shardMessage = message(tickShard);
+	switch (tick._type)
+	{
+	case Tick::Quote:
+		shardMessage->_quote = static_cast<const Quote&>(tick);
+		break;
+	case Tick::Trade:
+		shardMessage->_trade = static_cast<const Trade&>(tick);
+		break;
+	case Tick::MarketOrder:
+		shardMessage->_marketOrder = static_cast<const MarketOrder&>(tick);
+		break;
+	default:
+		printf("%s %s %d: unhandled tick type: %d\n", __FILE__, __FUNCTION__, __LINE__, tick._type);
+		return;
+	}
+	shardMessage->_type = ShardMessage::TickMessage;
+	tickShard->_input.push_back();
+
+	uint64_t time = nanoseconds(tick._ts);
+	if (time - _syncTime >= _syncInterval)
+	{
+		sendTime(tick._ts);
+		_syncTime = time;
+	}
+
+	// reports before every shard's watermark can no longer be preceded by another report
+	uint64_t limit(~0ULL);
+	for (Shard *shard : _shards)
+	{
+		uint64_t watermark = shard->_watermark.load(std::memory_order_acquire);
+		if (watermark < limit) limit = watermark;
+	}
+	collect();
+	publish(limit);
+}
+
+void ShardedExchangeSimulator::onOrder(Order *order)
+{
+	Shard *orderShard = shard(order->symbolId());
+	ShardMessage *shardMessage = message(orderShard);
+	shardMessage->_type = ShardMessage::OrderMessage;
+	shardMessage->_order = order;
+	orderShard->_input.push_back();
+}
+
+void ShardedExchangeSimulator::flush(const timespec &ts)
+{
+	sendTime(ts);
+	uint64_t time = nanoseconds(ts);
+	for (Shard *shard : _shards)
+	{
+		while (shard->_watermark.load(std::memory_order_acquire) < time)
+		{
+			collect();
+			std::this_thread::yield();
+		}
+	}
+	collect();
+	publish(~0ULL);
+	_syncTime = time;
+}
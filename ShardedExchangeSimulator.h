@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ExchangeSimulator.h"
+#include "SPSCBatchQueue.h"
+
+#include <atomic>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+** Sharded Exchange Simulator
+** - partitions symbols across worker threads, each shard owns an ExchangeSimulator and its TimeManager
+** - ticks and orders are routed to shards over SPSC queues, execution reports come back the same way
+** - reports are merged on the caller's thread in (time, symbol id, shard sequence) order so the output
+**   does not depend on thread scheduling, for one symbol it is the single threaded report sequence
+** - orders must not be received before the last tick time, the symbol registry must not grow while shards run
+*/
+class ShardedExchangeSimulator
+{
+protected:
+	struct ShardMessage
+	{
+		enum
+		{
+			TickMessage = 0,
+			OrderMessage = 1,
+			TimeMessage = 2,
+			StopMessage = 3
+		};
+		int _type;
+		union
+		{
+			Tick _tick;
+			Quote _quote;
+			Trade _trade;
+			MarketOrder _marketOrder;
+			Order *_order;
+			timespec _ts;
+		};
+		ShardMessage() : _type(StopMessage), _order(0) {}
+	};
+
+	struct ShardReport
+	{
+		uint64_t _time;
+		uint64_t _seq;
+		SimulatorExecutionReport _executionReport;
+	};
+
+	struct Shard final : public ExecutionReportCallback
+	{
+		unsigned _shardIdx;
+		TimeManager _timeManager;
+		ExchangeSimulator _exchange;
+		SPSCBatchQueue<ShardMessage> _input;
+		SPSCBatchQueue<ShardReport> _output;
+		uint64_t _seq;
+		std::thread _thread;
+		// no report earlier than this time is still to come from the shard
+		std::atomic<uint64_t> _watermark;
+		std::atomic<bool> _stopped;
+
+		Shard(unsigned shardIdx, uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, SymbolRegistry *symbolRegistry, unsigned queueSize);
+		void onExecution(SimulatorExecutionReport &executionReport);
+		void run();
+	};
+
+	struct ReportGreater
+	{
+		bool operator() (const ShardReport *l, const ShardReport *r) const;
+	};
+
+	std::vector<Shard*> _shards;
+	ExecutionReportCallback *_executionReportCallback;
+	bool _running;
+
+	// send time to every shard after this much tick time so the merge can move on
+	uint64_t _syncInterval;
+	uint64_t _syncTime;
+
+	// reports taken from the shards waiting for every shard to pass their time
+	std::vector<ShardReport*> _freeReports;
+	std::priority_queue<ShardReport*, std::vector<ShardReport*>, ReportGreater> _reports;
+
+	Shard *shard(SymbolId symbolId) { return _shards[symbolId % _shards.size()]; }
+	ShardMessage *message(Shard *shard);
+	void sendTime(const timespec &ts);
+	void collect();
+	void publish(uint64_t limit);
+public:
+	ShardedExchangeSimulator(unsigned shardCnt, uint64_t delayMicroseconds, size_t bookCnt, size_t orderCnt, SymbolRegistry *symbolRegistry, unsigned queueSize = 65536);
+
+	unsigned shardCnt() const { return static_cast<unsigned>(_shards.size()); }
+	// configure a shard's simulator before start
+	ExchangeSimulator &exchange(unsigned shardIdx) { return _shards[shardIdx]->_exchange; }
+	// merged reports are delivered on the caller's thread
+	void setExecutionReportCallback(ExecutionReportCallback *callback) { _executionReportCallback = callback; }
+	void setSyncInterval(uint64_t nanoseconds) { _syncInterval = nanoseconds; }
+	// create every shard's books for the symbol universe in the registry, after the shards are configured and before start
+	void createOrderBooks();
+
+	void start();
+	void onTick(const Tick &tick);
+	void onOrder(Order *order);
+	// advance every shard to ts and deliver all reports up to it
+	void flush(const timespec &ts);
+	void stop();
+
+	~ShardedExchangeSimulator();
+private:
+	ShardedExchangeSimulator(const ShardedExchangeSimulator&) = delete;
+	ShardedExchangeSimulator& operator = (const ShardedExchangeSimulator&) = delete;
+};
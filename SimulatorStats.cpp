@@ -0,0 +1,83 @@
+#include "SimulatorStats.h"
+
+#include <chrono>
+#include <string.h>
+
+namespace
+{
+#if SIMULATOR_STATS
+uint64_t steadyNanoseconds()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+#endif
+
+const char *StageNames[SimulatorStats::Stage::StageCnt] = { "onTick", "onQuote", "timeEvent", "cross", "report", "cross levels", "cross fills" };
+const char *CounterNames[SimulatorStats::Counter::CounterCnt] = { "executions", "price level allocations", "book order allocations" };
+} // namespace
+
+void Histogram::reset()
+{
+	memset(_buckets, 0, sizeof(_buckets));
+	_count = _sum = _max = 0;
+	_min = ~static_cast<uint64_t>(0);
+}
+
+uint64_t Histogram::percentile(double fraction) const
+{
+	if (!_count) return 0;
+	uint64_t target = static_cast<uint64_t>(fraction * _count + 0.5);
+	if (!target) target = 1;
+	uint64_t cnt(0);
+	for (unsigned bucket = 0; bucket < BucketCnt; ++bucket)
+	{
+		cnt += _buckets[bucket];
+		if (cnt >= target)
+		{
+			// the extremes are known exactly
+			uint64_t value = bucketValue(bucket);
+			return value < _min ? _min : value > _max ? _max : value;
+		}
+	}
+	return _max;
+}
+
+void SimulatorStats::reset()
+{
+#if SIMULATOR_STATS
+	for (Histogram &histogram : _stages)
+		histogram.reset();
+	memset(_counters, 0, sizeof(_counters));
+	_startTsc = readTsc();
+	_startNanoseconds = steadyNanoseconds();
+#endif
+}
+
+#if SIMULATOR_STATS
+double SimulatorStats::tscPerNanosecond() const
+{
+	uint64_t nanoseconds = steadyNanoseconds() - _startNanoseconds;
+	return nanoseconds ? static_cast<double>(readTsc() - _startTsc) / nanoseconds : 1.0;
+}
+#endif
+
+void SimulatorStats::dump(FILE *file) const
+{
+	if (!Enabled)
+	{
+		fprintf(file, "simulator stats not compiled in, build with SIMULATOR_STATS=1\n");
+		return;
+	}
+	double tscPerNanosecond = this->tscPerNanosecond();
+	fprintf(file, "%-14s %12s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+	for (int stage = 0; stage < Stage::StageCnt; ++stage)
+	{
+		const Histogram &histogram = *this->histogram(stage);
+		// cycles become nanoseconds, the per crossing counts stay counts
+		double scale = stage < Stage::CrossLevels ? 1.0 / tscPerNanosecond : 1.0;
+		fprintf(file, "%-14s %12llu %10.1f %10.0f %10.0f %10.0f %10.0f %10.0f\n", StageNames[stage], static_cast<unsigned long long>(histogram.count()), histogram.mean() * scale,
+			histogram.percentile(0.5) * scale, histogram.percentile(0.9) * scale, histogram.percentile(0.99) * scale, histogram.percentile(0.999) * scale, histogram.max() * scale);
+	}
+	for (int counter = 0; counter < Counter::CounterCnt; ++counter)
+		fprintf(file, "%-24s %12llu\n", CounterNames[counter], static_cast<unsigned long long>(this->counter(counter)));
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "BitOps.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if _MSC_VER
+#include <intrin.h>
+#elif !defined(__x86_64__) && !defined(__i386__)
+#include <chrono>
+#endif
+
+/*
+** SIMULATOR_STATS
+** - 1 compiles the stage timers and counters into the simulator, 0 leaves empty inline calls that compile away
+*/
+#ifndef SIMULATOR_STATS
+#define SIMULATOR_STATS 0
+#endif
+
+inline uint64_t readTsc()
+{
+#if _MSC_VER
+	return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+/*
+** Histogram
+** - log linear buckets: exact below 16, then 16 buckets per power of two, about 6% precision up to 2^64
+** - record is a few instructions and never allocates
+*/
+class Histogram
+{
+public:
+	enum
+	{
+		SubBucketBits = 4,
+		SubBucketCnt = 1 << SubBucketBits,
+		BucketCnt = SubBucketCnt + (64 - SubBucketBits) * SubBucketCnt
+	};
+protected:
+	uint64_t _buckets[BucketCnt];
+	uint64_t _count;
+	uint64_t _sum;
+	uint64_t _min;
+	uint64_t _max;
+public:
+	Histogram() { reset(); }
+	void reset();
+
+	void record(uint64_t value)
+	{
+		++_buckets[bucket(value)];
+		++_count;
+		_sum += value;
+		if (value < _min) _min = value;
+		if (value > _max) _max = value;
+	}
+
+	uint64_t count() const { return _count; }
+	uint64_t sum() const { return _sum; }
+	uint64_t min() const { return _count ? _min : 0; }
+	uint64_t max() const { return _max; }
+	double mean() const { return _count ? static_cast<double>(_sum) / _count : 0.0; }
+	// smallest bucket value with at least fraction of the values at or below its bucket
+	uint64_t percentile(double fraction) const;
+
+	static unsigned bucket(uint64_t value)
+	{
+		if (value < SubBucketCnt) return static_cast<unsigned>(value);
+		unsigned shift = highestBit(value) - SubBucketBits;
+		return SubBucketCnt + shift * SubBucketCnt + static_cast<unsigned>((value >> shift) & (SubBucketCnt - 1));
+	}
+	// lowest value in bucket
+	static uint64_t bucketValue(unsigned bucket)
+	{
+		if (bucket < SubBucketCnt) return bucket;
+		unsigned shift = (bucket - SubBucketCnt) / SubBucketCnt;
+		return static_cast<uint64_t>(SubBucketCnt + (bucket & (SubBucketCnt - 1))) << shift;
+	}
+};
+
+/*
+** SimulatorStats
+** - TSC cycles per stage and counts of the work done in them, one instance per simulator thread
+** - dump converts cycles to nanoseconds with the TSC rate measured since the stats were reset
+*/
+class SimulatorStats
+{
+public:
+	struct Stage
+	{
+		enum
+		{
+			// cycles
+			OnTick = 0,
+			OnQuote = 1,
+			TimeEvent = 2,
+			Cross = 3,
+			Report = 4,
+			// per crossing order
+			CrossLevels = 5,
+			CrossExecutions = 6,
+			StageCnt = 7
+		};
+	};
+	struct Counter
+	{
+		enum
+		{
+			Executions = 0,
+			PriceLevelAllocations = 1,
+			BookOrderAllocations = 2,
+			CounterCnt = 3
+		};
+	};
+	static const bool Enabled = SIMULATOR_STATS != 0;
+protected:
+#if SIMULATOR_STATS
+	Histogram _stages[Stage::StageCnt];
+	uint64_t _counters[Counter::CounterCnt];
+	uint64_t _startTsc;
+	uint64_t _startNanoseconds;
+#endif
+public:
+	SimulatorStats() { reset(); }
+	void reset();
+
+#if SIMULATOR_STATS
+	void record(int stage, uint64_t value) { _stages[stage].record(value); }
+	void count(int counter, uint64_t cnt = 1) { _counters[counter] += cnt; }
+
+	const Histogram *histogram(int stage) const { return &_stages[stage]; }
+	uint64_t counter(int counter) const { return _counters[counter]; }
+	double tscPerNanosecond() const;
+#else
+	void record(int, uint64_t) {}
+	void count(int, uint64_t = 1) {}
+
+	// 0 while disabled
+	const Histogram *histogram(int) const { return 0; }
+	uint64_t counter(int) const { return 0; }
+	double tscPerNanosecond() const { return 1.0; }
+#endif
+
+	// percentiles per stage and the counters, stages in nanoseconds
+	void dump(FILE *file = stdout) const;
+};
+
+/*
+** StageTimer
+** - records the cycles from construction to destruction in a stage
+*/
+class StageTimer
+{
+#if SIMULATOR_STATS
+	SimulatorStats &_stats;
+	int _stage;
+	uint64_t _start;
+public:
+	StageTimer(SimulatorStats &stats, int stage) : _stats(stats), _stage(stage), _start(readTsc()) {}
+	~StageTimer() { _stats.record(_stage, readTsc() - _start); }
+#else
+public:
+	StageTimer(SimulatorStats &, int) {}
+#endif
+private:
+	StageTimer(const StageTimer&) = delete;
+	StageTimer& operator = (const StageTimer&) = delete;
+};
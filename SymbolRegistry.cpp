@@ -0,0 +1,30 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "SymbolRegistry.h"
+
+#include <ctype.h>
+#include <stdio.h>
+
+int SymbolRegistry::load(const char *fileName)
+{
+	FILE *file = fopen(fileName, "r");
+	if (!file) return -1;
+
+	int cnt(0);
+	char line[256];
+	while (fgets(line, sizeof(line), file))
+	{
+		// trim whitespace, skip blank lines
+		char *begin = line;
+		while (isspace(static_cast<unsigned char>(*begin))) ++begin;
+		char *end = begin;
+		while (*end && !isspace(static_cast<unsigned char>(*end))) ++end;
+		if (begin == end) continue;
+		*end = 0;
+
+		intern(begin);
+		++cnt;
+	}
+	fclose(file);
+	return cnt;
+}
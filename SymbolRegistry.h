@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t SymbolId;
+
+/*
+** SymbolRegistry
+** - assigns dense ids to symbols the first time they are seen or loaded from a universe file
+** - ids index per symbol arrays, symbol strings are only needed at the edges
+*/
+class SymbolRegistry
+{
+protected:
+	std::vector<std::string> _symbols;
+	std::unordered_map<std::string, SymbolId> _symbolIds;
+public:
+	static const SymbolId InvalidSymbolId = ~0U;
+
+	SymbolRegistry(size_t symbolCnt = 0) { _symbols.reserve(symbolCnt); _symbolIds.reserve(symbolCnt); }
+
+	// id for symbol, a new id if it has not been seen
+	SymbolId intern(const char *symbol);
+	// id for symbol or InvalidSymbolId
+	SymbolId find(const char *symbol) const;
+	const char *symbol(SymbolId symbolId) const { return symbolId < _symbols.size() ? _symbols[symbolId].c_str() : ""; }
+	size_t size() const { return _symbols.size(); }
+
+	// intern one symbol per line, returns the number of lines read or -1 if the file cannot be read
+	int load(const char *fileName);
+private:
+	SymbolRegistry(const SymbolRegistry&) = delete;
+	SymbolRegistry& operator = (const SymbolRegistry&) = delete;
+};
+
+inline
+SymbolId SymbolRegistry::intern(const char *symbol)
+{
+	std::pair<std::unordered_map<std::string, SymbolId>::iterator, bool> result = _symbolIds.emplace(symbol, static_cast<SymbolId>(_symbols.size()));
+	if (result.second) _symbols.push_back(result.first->first);
+	return result.first->second;
+}
+
+inline
+SymbolId SymbolRegistry::find(const char *symbol) const
+{
+	std::unordered_map<std::string, SymbolId>::const_iterator itr = _symbolIds.find(symbol);
+	return itr != _symbolIds.end() ? itr->second : InvalidSymbolId;
+}
@@ -6,6 +6,7 @@
 
 #include "IntrusivePriorityQueue.h"
 
+#include <stdint.h>
 #include <time.h>
 
 class TimeEventObject: public Intrusive::HeapObject
@@ -47,14 +48,25 @@ protected:
 		}
 	};
 	Intrusive::PriorityQueue<TimeEventObject, TimeCallbackLess> _priorityQueue;
+	// time of the top callback, kept by every call that changes the queue
+	uint64_t _nextTime;
+
+	void topChanged()
+	{
+		TimeEventObject *cb = _priorityQueue.top();
+		_nextTime = cb ? static_cast<uint64_t>(cb->time().tv_sec) * 1000000000 + cb->time().tv_nsec : ~0ULL;
+	}
 public:
-	TimeManager(unsigned maxSize = 256) : _timespec({ 0, 0 }), _priorityQueue(maxSize) {}
+	TimeManager(unsigned maxSize = 256) : _timespec({ 0, 0 }), _priorityQueue(maxSize), _nextTime(~0ULL) {}
 
 	const timespec& time() const { return _timespec; }
 
-	void addCallback(TimeEventObject *cb) {_priorityQueue.push(cb);}
+	void addCallback(TimeEventObject *cb) { _priorityQueue.push(cb); topChanged(); }
+
+	void reprioritize(TimeEventObject *cb) { _priorityQueue.reprioritize(cb); topChanged(); }
 
-	void reprioritize(TimeEventObject *cb) { _priorityQueue.reprioritize(cb); }
+	// time of the earliest callback in nanoseconds, ~0 without one
+	uint64_t nextTime() const { return _nextTime; }
 
 	void setTime(const timespec &ts)
 	{
@@ -66,5 +78,6 @@ public:
 			cb->timeEvent(_timespec);
 		}
 		_timespec = ts;
+		topChanged();
 	}
 };
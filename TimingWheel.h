@@ -0,0 +1,165 @@
+#pragma once
+
+#include "IntrusiveLinkedList.h"
+#include "BitOps.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+/*
+** TimingWheel
+** - hierarchical timing wheel of intrusive objects keyed by time in nanoseconds
+** - 64 slots per level, level l holds objects whose time first differs from the wheel time in bits [6l, 6l + 6)
+**   so eleven levels cover every time without an overflow list
+** - insert is O(1), expire moves the wheel forward cascading only the slots it reaches
+** - objects with the same time expire in insertion order
+** - Type derives from Intrusive::LinkedListObject and provides uint64_t wheelTime() const
+*/
+template <typename Type>
+class TimingWheel
+{
+protected:
+	static const unsigned SlotBits = 6;
+	static const unsigned SlotCnt = 1 << SlotBits;
+	static const unsigned SlotMask = SlotCnt - 1;
+	static const unsigned LevelCnt = (64 + SlotBits - 1) / SlotBits;
+
+	Intrusive::LinkedList _slots[LevelCnt][SlotCnt];
+	uint64_t _occupied[LevelCnt];
+	uint64_t _now;
+	size_t _size;
+
+	static unsigned level(uint64_t time, uint64_t now)
+	{
+		uint64_t bits = time ^ now;
+		return bits ? highestBit(bits) / SlotBits : 0;
+	}
+	static unsigned slot(uint64_t time, unsigned level) { return (time >> (level * SlotBits)) & SlotMask; }
+	// first occupied slot at level from the wheel time's slot on, -1 if none
+	int nextSlot(unsigned level) const;
+	void place(Type *object, uint64_t time);
+public:
+	TimingWheel(uint64_t now = 0) : _now(now), _size(0) { for (unsigned l = 0; l < LevelCnt; ++l) _occupied[l] = 0; }
+
+	uint64_t now() const { return _now; }
+	// move an empty wheel to now
+	void reset(uint64_t now) { if (!_size) _now = now; }
+	size_t size() const { return _size; }
+	bool empty() const { return !_size; }
+
+	// objects earlier than the wheel time expire at the next expire call
+	void insert(Type *object);
+	// earliest object time, only meaningful if not empty
+	uint64_t nextTime() const;
+	// move the wheel to time appending the objects up to it to expired in time order
+	void expire(uint64_t time, Intrusive::LinkedList &expired);
+	// every object in the order expire would return them, inserting them in this order rebuilds the wheel
+	void objects(std::vector<Type*> &objects) const;
+private:
+	TimingWheel(const TimingWheel&) = delete;
+	TimingWheel& operator = (const TimingWheel&) = delete;
+};
+
+template <typename Type>
+int TimingWheel<Type>::nextSlot(unsigned level) const
+{
+	// slots before the wheel time's slot are empty at level 0 and behind it at the higher levels
+	uint64_t bits = _occupied[level] & (~0ULL << slot(_now, level));
+	return bits ? static_cast<int>(lowestBit(bits)) : -1;
+}
+
+template <typename Type>
+void TimingWheel<Type>::place(Type *object, uint64_t time)
+{
+	if (time < _now) time = _now;
+	unsigned l = level(time, _now), s = slot(time, l);
+	_slots[l][s].push_back(object);
+	_occupied[l] |= 1ULL << s;
+}
+
+template <typename Type>
+void TimingWheel<Type>::insert(Type *object)
+{
+	place(object, object->wheelTime());
+	++_size;
+}
+
+template <typename Type>
+uint64_t TimingWheel<Type>::nextTime() const
+{
+	for (unsigned l = 0; l < LevelCnt; ++l)
+	{
+		int s = nextSlot(l);
+		if (s < 0) continue;
+		if (!l) return (_now & ~static_cast<uint64_t>(SlotMask)) | s;
+
+		// a higher level slot spans many times, its earliest object is the next time
+		const Intrusive::LinkedList &slotList = _slots[l][s];
+		uint64_t time = ~0ULL;
+		for (const Intrusive::LinkedListObject *obj = slotList.begin(); obj != slotList.end(); obj = obj->next())
+		{
+			uint64_t objectTime = static_cast<const Type*>(obj)->wheelTime();
+			if (objectTime < time) time = objectTime;
+		}
+		return time;
+	}
+	return ~0ULL;
+}
+
+template <typename Type>
+void TimingWheel<Type>::expire(uint64_t time, Intrusive::LinkedList &expired)
+{
+	while (_size)
+	{
+		// every level 0 object is earlier than every level 1 object and so on
+		unsigned l = 0;
+		int s;
+		for (; l < LevelCnt && (s = nextSlot(l)) < 0; ++l);
+
+		uint64_t shift = l * SlotBits;
+		uint64_t lowMask = shift + SlotBits < 64 ? (1ULL << (shift + SlotBits)) - 1 : ~0ULL;
+		uint64_t slotTime = (_now & ~lowMask) | (static_cast<uint64_t>(s) << shift);
+		if (slotTime > time) break;
+		_now = slotTime;
+
+		Intrusive::LinkedList &slotList = _slots[l][s];
+		_occupied[l] &= ~(1ULL << s);
+		if (!l)
+		{
+			for (Intrusive::LinkedListObject *obj = slotList.begin(); obj != slotList.end(); obj = slotList.begin())
+			{
+				obj->unlink();
+				expired.push_back(obj);
+				--_size;
+			}
+			continue;
+		}
+
+		// cascade the slot to the lower levels in order
+		for (Intrusive::LinkedListObject *obj = slotList.begin(); obj != slotList.end(); obj = slotList.begin())
+		{
+			obj->unlink();
+			Type *object = static_cast<Type*>(obj);
+			place(object, object->wheelTime());
+		}
+	}
+	if (time > _now) _now = time;
+}
+
+template <typename Type>
+void TimingWheel<Type>::objects(std::vector<Type*> &objects) const
+{
+	// objects clamped to the wheel time sit in its slot, equal times share a slot in insertion order
+	objects.clear();
+	for (unsigned l = 0; l < LevelCnt; ++l)
+		for (unsigned s = 0; s < SlotCnt; ++s)
+			for (const Intrusive::LinkedListObject *obj = _slots[l][s].begin(); obj != _slots[l][s].end(); obj = obj->next())
+				objects.push_back(static_cast<Type*>(const_cast<Intrusive::LinkedListObject*>(obj)));
+	uint64_t now = _now;
+	std::stable_sort(objects.begin(), objects.end(), [now](const Type *l, const Type *r)
+	{
+		uint64_t lTime = l->wheelTime(), rTime = r->wheelTime();
+		return (lTime < now ? now : lTime) < (rTime < now ? now : rTime);
+	});
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <thread>
+
+#if _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/*
+** WaitStrategy
+** - how a queue consumer waits in front_wait/pop_wait, a policy template parameter of the queues
+** - wait returns once ready() holds or false after timeoutNanoseconds, ~0 waits for ever
+** - word is the index the producer stores when it publishes and expected its value while the consumer has nothing,
+**   only the parking strategy uses them
+** - notify runs on the producer after every publish, it is empty except for the parking strategy
+*/
+inline void cpuPause()
+{
+#if _MSC_VER
+	_mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+class WaitDeadline
+{
+private:
+	std::chrono::steady_clock::time_point m_deadline;
+	bool m_forever;
+public:
+	WaitDeadline(uint64_t timeoutNanoseconds) : m_forever(timeoutNanoseconds == ~0ULL)
+	{
+		if (!m_forever) m_deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNanoseconds);
+	}
+	bool expired() const { return !m_forever && std::chrono::steady_clock::now() >= m_deadline; }
+	// nanoseconds left, ~0 for ever
+	uint64_t remaining() const
+	{
+		if (m_forever) return ~0ULL;
+		std::chrono::steady_clock::duration left = m_deadline - std::chrono::steady_clock::now();
+		return left.count() > 0 ? std::chrono::duration_cast<std::chrono::nanoseconds>(left).count() : 0;
+	}
+};
+
+// busy poll, lowest latency, burns the core
+struct SpinWait
+{
+	template <typename Ready>
+	bool wait(std::atomic<unsigned> &, unsigned, Ready ready, uint64_t timeoutNanoseconds)
+	{
+		WaitDeadline deadline(timeoutNanoseconds);
+		while (!ready())
+			if (deadline.expired()) return false;
+		return true;
+	}
+	void notify(std::atomic<unsigned> &) {}
+};
+
+// busy poll with a pause between polls, leaves the pipeline to the sibling hyperthread and exits the loop without a memory order flush
+struct PauseSpinWait
+{
+	template <typename Ready>
+	bool wait(std::atomic<unsigned> &, unsigned, Ready ready, uint64_t timeoutNanoseconds)
+	{
+		WaitDeadline deadline(timeoutNanoseconds);
+		while (!ready())
+		{
+			if (deadline.expired()) return false;
+			cpuPause();
+		}
+		return true;
+	}
+	void notify(std::atomic<unsigned> &) {}
+};
+
+// poll and give the core to other threads between polls
+struct YieldWait
+{
+	template <typename Ready>
+	bool wait(std::atomic<unsigned> &, unsigned, Ready ready, uint64_t timeoutNanoseconds)
+	{
+		WaitDeadline deadline(timeoutNanoseconds);
+		while (!ready())
+		{
+			if (deadline.expired()) return false;
+			std::this_thread::yield();
+		}
+		return true;
+	}
+	void notify(std::atomic<unsigned> &) {}
+};
+
+/*
+** ParkWait
+** - spins for a while, then sleeps on the futex of word until the producer changes it
+** - the producer pays a fence and a load per publish and makes the wake syscall only while a consumer is parked
+** - yields instead of sleeping where there is no futex
+*/
+class ParkWait
+{
+private:
+	enum
+	{
+		// a pause is over 100 cycles on recent cores, 1024 of them spun for tens of microseconds before parking
+		SpinCnt = 128
+	};
+	std::atomic<unsigned> m_aParked{ 0 };
+	static_assert(sizeof(std::atomic<unsigned>) == sizeof(unsigned), "futex word must be a plain 32 bit integer");
+public:
+	template <typename Ready>
+	bool wait(std::atomic<unsigned> &word, unsigned expected, Ready ready, uint64_t timeoutNanoseconds)
+	{
+		for (unsigned spin = 0; spin < SpinCnt; ++spin)
+		{
+			if (ready()) return true;
+			cpuPause();
+		}
+		WaitDeadline deadline(timeoutNanoseconds);
+		while (!ready())
+		{
+			uint64_t remaining = deadline.remaining();
+			if (!remaining) return false;
+#if defined(__linux__)
+			m_aParked.fetch_add(1);
+			// pairs with the fence in notify: either the producer sees the consumer parked or the consumer sees the new index
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!ready())
+			{
+				timespec timeout = { static_cast<time_t>(remaining / 1000000000), static_cast<long>(remaining % 1000000000) };
+				// the kernel compares word with expected before sleeping, a publish in between returns at once
+				syscall(SYS_futex, reinterpret_cast<unsigned*>(&word), FUTEX_WAIT_PRIVATE, expected, remaining == ~0ULL ? nullptr : &timeout, nullptr, 0);
+			}
+			m_aParked.fetch_sub(1, std::memory_order_relaxed);
+#else
+			std::this_thread::yield();
+#endif
+		}
+		return true;
+	}
+
+	void notify(std::atomic<unsigned> &word)
+	{
+#if defined(__linux__)
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_aParked.load(std::memory_order_relaxed))
+			syscall(SYS_futex, reinterpret_cast<unsigned*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+	}
+};
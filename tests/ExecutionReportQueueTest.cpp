@@ -0,0 +1,98 @@
+/*
+** ExecutionReportQueueTest
+** - more reports than the execution report queue holds with the consumer on the simulator's thread:
+**   the overflow is dropped and counted instead of waiting for a drain that can never run
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -I.. ExecutionReportQueueTest.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp
+*/
+#include "ExchangeSimulator.h"
+#include "FixMsgType.h"
+#include "Order.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+class TestOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	TestOrder() { memset(&_common, 0, sizeof(_common)); _chainCommon = &_common; }
+	void set(SymbolId symbolId, uint64_t clOrdId, unsigned price, const timespec &ts)
+	{
+		newOrder(symbolId, '1', 100, price, ts);
+		_msgType = FIX::MsgType::NewOrder;
+		_clOrdId = clOrdId;
+	}
+};
+
+struct ReportCollector : public ExecutionReportCallback
+{
+	std::vector<uint64_t> _clOrdIds;
+	void onExecution(SimulatorExecutionReport &executionReport) { _clOrdIds.push_back(executionReport._clOrdId); }
+};
+
+enum
+{
+	QueueCapacity = 4,
+	OrderCnt = 10
+};
+
+int failures(0);
+} // namespace
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+int main()
+{
+	SymbolRegistry symbolRegistry;
+	SymbolId symbolId = symbolRegistry.intern("MSFT");
+	TimeManager timeManager;
+	ExchangeSimulator exchange(0, 16, 1024, &timeManager, &symbolRegistry);
+	ExecutionReportQueue executionReportQueue(QueueCapacity);
+	exchange.setExecutionReportQueue(&executionReportQueue);
+
+	Quote quote;
+	memset(&quote, 0, sizeof(quote));
+	quote._type = Tick::Quote;
+	quote._symbolId = symbolId;
+	quote._price[0] = 100;
+	quote._price[1] = 102;
+	quote._size[0] = quote._size[1] = 500;
+	timespec ts = { 1000, 0 };
+	quote._ts = ts;
+	exchange.onTick(quote);
+
+	// one New report per resting bid, all due at the next tick
+	std::vector<TestOrder> orders(OrderCnt + 1);
+	for (int idx = 0; idx < OrderCnt; ++idx)
+	{
+		orders[idx].set(symbolId, idx + 1, 90 - idx, ts);
+		exchange.onOrder(&orders[idx]);
+	}
+	ts.tv_nsec += 1000;
+	quote._ts = ts;
+	exchange.onTick(quote);
+
+	ReportCollector collector;
+	CHECK(exchange.droppedExecutionReports() == OrderCnt - QueueCapacity, "overflow not counted");
+	CHECK(drainExecutionReports(executionReportQueue, collector) == QueueCapacity, "queue not full");
+	for (size_t idx = 0; idx < collector._clOrdIds.size(); ++idx)
+		CHECK(collector._clOrdIds[idx] == idx + 1, "queued reports out of order");
+
+	// the drained queue takes reports again
+	orders[OrderCnt].set(symbolId, OrderCnt + 1, 80, ts);
+	exchange.onOrder(&orders[OrderCnt]);
+	ts.tv_nsec += 1000;
+	quote._ts = ts;
+	exchange.onTick(quote);
+	CHECK(drainExecutionReports(executionReportQueue, collector) == 1 && collector._clOrdIds.back() == OrderCnt + 1, "report after the drain");
+	CHECK(exchange.droppedExecutionReports() == OrderCnt - QueueCapacity, "report after the drain counted as dropped");
+
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
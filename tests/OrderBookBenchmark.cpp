@@ -0,0 +1,192 @@
+/*
+** OrderBookBenchmark
+** - simulated orders into one book, with and without the tick indexed price ladder
+** - passive: limit orders resting up to depth ticks behind the quote, each one a price level lookup and insert
+** - aggressive: limit orders through the quote, each one a cross
+** - side walk: the cross loop's level walk alone, SideTraits<SIDE>::inside against the runtime inside function pointer
+**   the matching paths used before they were specialized by side
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -O2 -I.. OrderBookBenchmark.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp
+** - usage: OrderBookBenchmark [depth]
+*/
+#include "ExchangeSimulator.h"
+#include "FixMsgType.h"
+#include "Order.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+class BenchmarkOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	BenchmarkOrder() { memset(&_common, 0, sizeof(_common)); _chainCommon = &_common; }
+	void set(SymbolId symbolId, char side, uint64_t clOrdId, unsigned orderQty, unsigned price, const timespec &ts)
+	{
+		newOrder(symbolId, side, orderQty, price, ts);
+		_msgType = FIX::MsgType::NewOrder;
+		_clOrdId = clOrdId;
+	}
+};
+
+struct NullCallback : public ExecutionReportCallback
+{
+	size_t _cnt;
+	NullCallback() : _cnt(0) {}
+	void onExecution(SimulatorExecutionReport&) { ++_cnt; }
+};
+
+enum
+{
+	PassiveCnt = 200000,
+	AggressiveCnt = 20000,
+	Repetitions = 5
+};
+
+// best of the repetitions in nanoseconds per order
+void run(unsigned depth, bool ladder, double &passive, double &aggressive)
+{
+	passive = aggressive = 1e18;
+	for (int repetition = 0; repetition < Repetitions; ++repetition)
+	{
+		SymbolRegistry symbolRegistry;
+		SymbolId symbolId = symbolRegistry.intern("X");
+		TimeManager timeManager;
+		ExchangeSimulator exchange(0, 16, 1 << 20, &timeManager, &symbolRegistry);
+		NullCallback callback;
+		exchange.setExecutionReportCallback(&callback);
+		if (ladder) exchange.setPriceLadder(2 * depth + 64, 1);
+
+		std::vector<BenchmarkOrder> orders(PassiveCnt + AggressiveCnt);
+		std::mt19937 random(3);
+		Quote quote;
+		memset(&quote, 0, sizeof(quote));
+		quote._type = Tick::Quote;
+		quote._symbolId = symbolId;
+		quote._price[0] = 99999;
+		quote._price[1] = 100001;
+		quote._size[0] = quote._size[1] = 1;
+		timespec ts = { 1000, 0 };
+		quote._ts = ts;
+		exchange.onTick(quote);
+
+		// each order arrives with the next quote
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int idx = 0; idx < PassiveCnt + AggressiveCnt; ++idx)
+		{
+			if (idx == PassiveCnt)
+			{
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				passive = std::min(passive, std::chrono::duration<double, std::nano>(now - start).count() / PassiveCnt);
+				start = now;
+			}
+			bool buy = random() % 2;
+			unsigned price = idx < PassiveCnt ? (buy ? 99999 - 1 - random() % depth : 100001 + 1 + random() % depth) : (buy ? 100001 + depth : 99999 - depth);
+			unsigned orderQty = idx < PassiveCnt ? 100 : 100 + random() % 2000;
+			orders[idx].set(symbolId, buy ? '1' : '2', idx + 1, orderQty, price, ts);
+			exchange.onOrder(&orders[idx]);
+			ts.tv_nsec += 10;
+			quote._ts = ts;
+			exchange.onTick(quote);
+		}
+		aggressive = std::min(aggressive, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / AggressiveCnt);
+	}
+}
+// the comparison the matching paths picked by side at run time before SideTraits
+bool higher(unsigned l, unsigned r) { return l > r; }
+bool lower(unsigned l, unsigned r) { return l < r; }
+
+// levels an order at price crosses, levels are sorted from the top of book out
+unsigned crossedRuntime(int side, const std::vector<unsigned> &levels, unsigned price)
+{
+	bool(*inside) (unsigned, unsigned) = side ? lower : higher;
+	unsigned cnt(0);
+	for (unsigned level : levels)
+	{
+		if (inside(level, price)) break;
+		++cnt;
+	}
+	return cnt;
+}
+
+template <int SIDE>
+unsigned crossed(const std::vector<unsigned> &levels, unsigned price)
+{
+	unsigned cnt(0);
+	for (unsigned level : levels)
+	{
+		if (SideTraits<SIDE>::inside(level, price)) break;
+		++cnt;
+	}
+	return cnt;
+}
+
+// best of the repetitions in nanoseconds per order, orders of both sides cross up to depth levels of the other side
+void runSideWalk(unsigned depth, double &runtime, double &specialized)
+{
+	enum { WalkCnt = 1000000 };
+	std::vector<unsigned> levels[2];
+	for (unsigned level = 0; level < depth; ++level)
+	{
+		levels[0].push_back(99999 - level);
+		levels[1].push_back(100001 + level);
+	}
+	std::vector<int> sides(WalkCnt);
+	std::vector<unsigned> prices(WalkCnt);
+	std::mt19937 random(5);
+	for (int idx = 0; idx < WalkCnt; ++idx)
+	{
+		// a buy crosses the sell levels and a sell the buy levels
+		sides[idx] = random() % 2;
+		prices[idx] = sides[idx] ? 99999 - random() % depth : 100001 + random() % depth;
+	}
+
+	runtime = specialized = 1e18;
+	unsigned runtimeCnt(0), specializedCnt(0);
+	for (int repetition = 0; repetition < Repetitions; ++repetition)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int idx = 0; idx < WalkCnt; ++idx)
+			runtimeCnt += crossedRuntime(sides[idx], levels[!sides[idx]], prices[idx]);
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		runtime = std::min(runtime, std::chrono::duration<double, std::nano>(now - start).count() / WalkCnt);
+		start = now;
+		for (int idx = 0; idx < WalkCnt; ++idx)
+			specializedCnt += sides[idx] ? crossed<1>(levels[0], prices[idx]) : crossed<0>(levels[1], prices[idx]);
+		specialized = std::min(specialized, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / WalkCnt);
+	}
+	if (runtimeCnt != specializedCnt) printf("%s %s %d: ERROR: walks differ\n", __FILE__, __FUNCTION__, __LINE__);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+	std::vector<unsigned> depths;
+	if (argc > 1) depths.push_back(atoi(argv[1]));
+	else depths = { 10, 100, 1000 };
+	printf("%8s %22s %22s %22s %22s\n", "depth", "list passive ns", "ladder passive ns", "list aggressive ns", "ladder aggressive ns");
+	for (unsigned depth : depths)
+	{
+		double listPassive, listAggressive, ladderPassive, ladderAggressive;
+		run(depth, false, listPassive, listAggressive);
+		run(depth, true, ladderPassive, ladderAggressive);
+		printf("%8u %22.1f %22.1f %22.1f %22.1f\n", depth, listPassive, ladderPassive, listAggressive, ladderAggressive);
+	}
+
+	printf("\n%8s %22s %22s\n", "depth", "runtime side walk ns", "SideTraits walk ns");
+	for (unsigned depth : depths)
+	{
+		double runtime, specialized;
+		runSideWalk(depth, runtime, specialized);
+		printf("%8u %22.1f %22.1f\n", depth, runtime, specialized);
+	}
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+** OrderQueueTest
+** - the same orders written to the OrderQueue by different numbers of threads in different orders give the same reports,
+**   including orders of different threads that reuse a transact time and clOrdId, one of which is rejected as a duplicate
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -I.. OrderQueueTest.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp -lpthread
+*/
+#include "ExchangeSimulator.h"
+#include "FixExecType.h"
+#include "FixMsgType.h"
+#include "FixOrdStatus.h"
+#include "Order.h"
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+class TestOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	TestOrder(SymbolId symbolId, char side, uint64_t clOrdId, unsigned orderQty, unsigned price, const timespec &ts)
+	{
+		memset(&_common, 0, sizeof(_common));
+		_chainCommon = &_common;
+		newOrder(symbolId, side, orderQty, price, ts);
+		_msgType = FIX::MsgType::NewOrder;
+		_clOrdId = clOrdId;
+	}
+};
+
+class ReportLog : public ExecutionReportCallback
+{
+public:
+	std::string _log;
+	void onExecution(SimulatorExecutionReport &executionReport)
+	{
+		char line[128];
+		snprintf(line, sizeof(line), "%llu %c %c %c %u %u %llu\n", static_cast<unsigned long long>(executionReport._clOrdId), executionReport._execType,
+			executionReport._ordStatus, executionReport._side, executionReport._lastPx, executionReport._lastQty, static_cast<unsigned long long>(executionReport._transactTime));
+		_log += line;
+	}
+};
+
+int failures(0);
+} // namespace
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+int main()
+{
+	enum { StepCnt = 3, OrderCnt = 12, RoundCnt = 12 };
+	SymbolRegistry symbolRegistry;
+	SymbolId symbolId = symbolRegistry.intern("MSFT");
+
+	// each step's orders, the last four of a step are two pairs sharing a transact time and clOrdId,
+	// one pair differs in side and price, the other pair is the same order twice
+	std::deque<TestOrder> orders;
+	for (unsigned step = 0; step < StepCnt; ++step)
+	{
+		timespec ts = { 1000, static_cast<long>(step * 1000) };
+		for (unsigned idx = 0; idx < OrderCnt - 4; ++idx)
+		{
+			bool buy = idx % 2 == 0;
+			orders.emplace_back(symbolId, buy ? '1' : '2', step * 100 + idx + 1, 100 + idx * 10, buy ? 1000 - idx % 4 + 1 : 1010 + idx % 4 - 1, ts);
+		}
+		orders.emplace_back(symbolId, '1', step * 100 + 50, 100, 1001, ts);
+		orders.emplace_back(symbolId, '2', step * 100 + 50, 100, 1009, ts);
+		orders.emplace_back(symbolId, '1', step * 100 + 60, 100, 999, ts);
+		orders.emplace_back(symbolId, '1', step * 100 + 60, 100, 999, ts);
+	}
+
+	std::string first;
+	for (unsigned round = 0; round < RoundCnt; ++round)
+	{
+		TimeManager timeManager;
+		ExchangeSimulator exchange(0, 4, 256, &timeManager, &symbolRegistry);
+		ReportLog reportLog;
+		exchange.setExecutionReportCallback(&reportLog);
+		OrderQueue orderQueue(64);
+		exchange.setOrderQueue(&orderQueue);
+
+		Quote quote;
+		memset(&quote, 0, sizeof(quote));
+		quote._type = Tick::Quote;
+		quote._symbolId = symbolId;
+		quote._price[0] = 1000;
+		quote._price[1] = 1010;
+		quote._size[0] = quote._size[1] = 500;
+		std::mt19937 random(round);
+		for (unsigned step = 0; step < StepCnt; ++step)
+		{
+			// a different number of threads each round, each one writing a shuffled share of the step's orders
+			std::vector<Order*> stepOrders;
+			for (unsigned idx = 0; idx < OrderCnt; ++idx)
+				stepOrders.push_back(&orders[step * OrderCnt + idx]);
+			std::shuffle(stepOrders.begin(), stepOrders.end(), random);
+			unsigned threadCnt = 1 + round % 4;
+			std::vector<std::thread> threads;
+			for (unsigned thread = 0; thread < threadCnt; ++thread)
+			{
+				threads.emplace_back([&orderQueue, &stepOrders, thread, threadCnt]
+				{
+					for (size_t idx = thread; idx < stepOrders.size(); idx += threadCnt)
+						while (!orderQueue.write(stepOrders[idx])) std::this_thread::yield();
+				});
+			}
+			for (std::thread &thread : threads)
+				thread.join();
+
+			quote._ts.tv_sec = 1000;
+			quote._ts.tv_nsec = step * 1000 + 500;
+			exchange.onTick(quote);
+		}
+		quote._ts.tv_nsec = StepCnt * 1000;
+		exchange.onTick(quote);
+
+		if (!round) first = reportLog._log;
+		else CHECK(reportLog._log == first, "reports depend on the interleaving");
+	}
+	CHECK(std::count(first.begin(), first.end(), '\n') == StepCnt * OrderCnt, "not one report per order");
+	char accepted[32], rejected[32];
+	snprintf(accepted, sizeof(accepted), "\n50 %c %c 1 ", FIX::ExecType::New, FIX::OrdStatus::New);
+	snprintf(rejected, sizeof(rejected), "\n50 %c %c 2 ", FIX::ExecType::Rejected, FIX::OrdStatus::Rejected);
+	CHECK(first.find(accepted) != std::string::npos && first.find(rejected) != std::string::npos, "duplicate tie not broken by side");
+
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
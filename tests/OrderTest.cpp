@@ -0,0 +1,52 @@
+/*
+** OrderTest
+** - Order::newOrder fills in the chain common record the owner attached
+** - builds in the full trading tree only: Order.h includes FixSide.h, which is not in this snapshot, there:
+**   g++ -std=c++14 -I.. OrderTest.cpp ../SymbolRegistry.cpp
+*/
+#include "Order.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+class TestOrder : public Order
+{
+public:
+	ChainCommon _common;
+	TestOrder(bool attached)
+	{
+		memset(&_common, 0xff, sizeof(_common));
+		_chainCommon = attached ? &_common : 0;
+	}
+};
+
+int failures(0);
+} // namespace
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+int main()
+{
+	SymbolRegistry symbolRegistry;
+	SymbolId symbolId = symbolRegistry.intern("MSFT");
+	timespec ts = { 1000, 5 };
+
+	TestOrder sell(true);
+	CHECK(!sell.newOrder(symbolId, '2', 300, 101, ts), "newOrder failed");
+	CHECK(sell.symbolId() == symbolId, "symbolId not stored");
+	CHECK(sell.side() == '2', "side not stored");
+	CHECK(sell.sideId() == 1, "sideId not derived from side");
+	CHECK(sell.orderQty() == 300 && sell.price() == 101, "qty or price not stored");
+
+	TestOrder buy(true);
+	CHECK(!buy.newOrder(symbolRegistry.intern("AAPL"), '1', 100, 99, ts), "newOrder failed");
+	CHECK(buy.symbolId() != symbolId && buy.side() == '1' && buy.sideId() == 0, "second chain mixed up");
+
+	TestOrder detached(false);
+	CHECK(detached.newOrder(symbolId, '1', 100, 99, ts) == -1, "newOrder without a chain common record");
+
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+/*
+** ParameterSweepTest
+** - runs with different order offsets and latencies replay one shared TickBuffer on a thread pool,
+**   with small tick blocks so runs move between workers, each run's reports match the same run replayed alone
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -I.. ParameterSweepTest.cpp ../ParameterSweep.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp -lpthread
+*/
+#include "ParameterSweep.h"
+#include "FixMsgType.h"
+#include "Order.h"
+
+#include <deque>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+class TestOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	TestOrder(SymbolId symbolId, char side, uint64_t clOrdId, unsigned orderQty, unsigned price, const timespec &ts)
+	{
+		memset(&_common, 0, sizeof(_common));
+		_chainCommon = &_common;
+		newOrder(symbolId, side, orderQty, price, ts);
+		_msgType = FIX::MsgType::NewOrder;
+		_clOrdId = clOrdId;
+	}
+};
+
+// every tenth quote it sends an order offset ticks behind the quote, alternating buys and sells
+class TestRun : public SweepRun, public ExecutionReportCallback
+{
+protected:
+	unsigned _offset;
+	std::deque<TestOrder> _orders;
+public:
+	std::string _log;
+	TestRun(uint64_t delayMicroseconds, unsigned offset, SymbolRegistry *symbolRegistry) : SweepRun(delayMicroseconds, 4, 1024, symbolRegistry), _offset(offset) {}
+	void start() { _exchange.setExecutionReportCallback(this); }
+	void onTicks(const Tick *const *ticks, size_t tickCnt)
+	{
+		for (size_t idx = 0; idx < tickCnt; ++idx)
+		{
+			_exchange.onTicks(ticks + idx, 1);
+			if (ticks[idx]->_type != Tick::Quote || (ticks[idx]->_ts.tv_nsec / 1000) % 10) continue;
+			const Quote &quote = *static_cast<const Quote*>(ticks[idx]);
+			bool buy = _orders.size() % 2 == 0;
+			unsigned price = buy ? quote._price[0] + 1 - _offset : quote._price[1] - 1 + _offset;
+			_orders.emplace_back(quote._symbolId, buy ? '1' : '2', _orders.size() + 1, 100, price, quote._ts);
+			_exchange.onOrder(&_orders.back());
+		}
+	}
+	void onExecution(SimulatorExecutionReport &executionReport)
+	{
+		char line[128];
+		snprintf(line, sizeof(line), "%llu %c %u %u %llu\n", static_cast<unsigned long long>(executionReport._clOrdId), executionReport._execType,
+			executionReport._lastPx, executionReport._lastQty, static_cast<unsigned long long>(executionReport._transactTime));
+		_log += line;
+	}
+};
+
+int failures(0);
+} // namespace
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+int main()
+{
+	enum { TickCnt = 20000, RunCnt = 8 };
+	SymbolRegistry symbolRegistry;
+	SymbolId symbolIds[] = { symbolRegistry.intern("MSFT"), symbolRegistry.intern("AAPL") };
+
+	// a random walk of quotes with trades at the quote, one tick per microsecond
+	TickBuffer tickBuffer;
+	tickBuffer.reserve(TickCnt);
+	std::mt19937 random(7);
+	unsigned mid[2] = { 10000, 20000 };
+	for (unsigned idx = 0; idx < TickCnt; ++idx)
+	{
+		unsigned book = random() % 2;
+		timespec ts = { static_cast<time_t>(1000 + idx / 1000000), static_cast<long>(idx % 1000000 * 1000) };
+		if (random() % 4)
+		{
+			mid[book] += random() % 3 - 1;
+			Quote quote;
+			memset(&quote, 0, sizeof(quote));
+			quote._type = Tick::Quote;
+			quote._symbolId = symbolIds[book];
+			quote._ts = ts;
+			quote._price[0] = mid[book] - 1;
+			quote._price[1] = mid[book] + 1;
+			quote._size[0] = quote._size[1] = 100 + random() % 400;
+			tickBuffer.add(quote);
+		}
+		else
+		{
+			Trade trade;
+			memset(&trade, 0, sizeof(trade));
+			trade._type = Tick::Trade;
+			trade._symbolId = symbolIds[book];
+			trade._ts = ts;
+			trade._price = mid[book] + (random() % 2 ? 1 : -1);
+			trade._size = 100 + random() % 200;
+			tickBuffer.add(trade);
+		}
+	}
+
+	std::vector<TestRun*> runs, serialRuns;
+	for (unsigned idx = 0; idx < RunCnt; ++idx)
+	{
+		runs.push_back(new TestRun(idx % 2 * 5, idx / 2, &symbolRegistry));
+		serialRuns.push_back(new TestRun(idx % 2 * 5, idx / 2, &symbolRegistry));
+	}
+
+	// blocks of 7 ticks hand runs back and forth between the workers
+	ParameterSweep sweep(tickBuffer, 4, 7);
+	for (TestRun *run : runs)
+		sweep.add(run);
+	sweep.run();
+
+	const Tick *const *ticks = tickBuffer.ticks();
+	for (unsigned idx = 0; idx < RunCnt; ++idx)
+	{
+		serialRuns[idx]->start();
+		serialRuns[idx]->onTicks(ticks, tickBuffer.size());
+		serialRuns[idx]->finish();
+		CHECK(!serialRuns[idx]->_log.empty(), "run without reports");
+		CHECK(runs[idx]->_log == serialRuns[idx]->_log, "sweep run reports differ from the run alone");
+	}
+	CHECK(runs[0]->_log != runs[RunCnt - 1]->_log, "parameters made no difference");
+
+	for (unsigned idx = 0; idx < RunCnt; ++idx)
+	{
+		delete runs[idx];
+		delete serialRuns[idx];
+	}
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
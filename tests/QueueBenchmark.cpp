@@ -0,0 +1,393 @@
+/*
+** QueueBenchmark
+** - MPSCQueue throughput as producers are added, against a std::deque behind a mutex
+** - MPMCQueue with as many consumers as producers, single and batch calls, against a deque behind a mutex and condition variables
+** - SPSCBatchQueue against SPSCQueue: throughput with single element and batch calls, and the round trip of a ping-pong over two rings
+** - each producer writes its share of MessageCnt values, the consumers read them all, best of the repetitions
+** - g++ -std=c++14 -O2 -I.. QueueBenchmark.cpp -lpthread
+** - usage: QueueBenchmark [producers]
+*/
+#include "MPMCQueue.h"
+#include "MPSCQueue.h"
+#include "SPSCBatchQueue.h"
+#include "SPSCQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+enum
+{
+	MessageCnt = 1 << 21,
+	Capacity = 1024,
+	Repetitions = 3
+};
+
+// the baseline: one lock around a deque bounded to the ring's capacity
+template <typename T>
+class MutexQueue
+{
+private:
+	std::mutex _mutex;
+	std::deque<T> _values;
+	size_t _capacity;
+public:
+	MutexQueue(size_t capacity) : _capacity(capacity) {}
+	bool write(const T &value)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_values.size() == _capacity) return false;
+		_values.push_back(value);
+		return true;
+	}
+	bool read(T &value)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_values.empty()) return false;
+		value = _values.front();
+		_values.pop_front();
+		return true;
+	}
+};
+
+// the blocking baseline: producers wait while the deque is full, consumers while it is empty
+template <typename T>
+class CondvarQueue
+{
+private:
+	std::mutex _mutex;
+	std::condition_variable _notFull;
+	std::condition_variable _notEmpty;
+	std::deque<T> _values;
+	size_t _capacity;
+public:
+	CondvarQueue(size_t capacity) : _capacity(capacity) {}
+	void push(const T &value)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notFull.wait(lock, [this] { return _values.size() < _capacity; });
+		_values.push_back(value);
+		lock.unlock();
+		_notEmpty.notify_one();
+	}
+	void pop(T &value)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notEmpty.wait(lock, [this] { return !_values.empty(); });
+		value = _values.front();
+		_values.pop_front();
+		lock.unlock();
+		_notFull.notify_one();
+	}
+};
+
+struct MPSCReader
+{
+	MPSCQueue<uint64_t> &_queue;
+	bool read(uint64_t &value)
+	{
+		uint64_t *front = _queue.front();
+		if (!front) return false;
+		value = *front;
+		_queue.pop_front();
+		return true;
+	}
+};
+
+// nanoseconds per message
+template <typename Queue, typename Reader>
+double run(Queue &queue, Reader &reader, unsigned producerCnt)
+{
+	uint64_t valueCnt = MessageCnt / producerCnt;
+	std::atomic<bool> start(false);
+	std::vector<std::thread> producers;
+	for (unsigned producer = 0; producer < producerCnt; ++producer)
+	{
+		producers.emplace_back([&queue, &start, valueCnt]
+		{
+			while (!start.load()) std::this_thread::yield();
+			for (uint64_t idx = 0; idx < valueCnt; ++idx)
+				while (!queue.write(idx)) std::this_thread::yield();
+		});
+	}
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	start = true;
+	uint64_t sum(0);
+	for (uint64_t cnt = 0, value; cnt < valueCnt * producerCnt;)
+	{
+		if (reader.read(value))
+		{
+			sum += value;
+			++cnt;
+		}
+		else std::this_thread::yield();
+	}
+	double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+	for (std::thread &thread : producers)
+		thread.join();
+	if (sum != producerCnt * (valueCnt * (valueCnt - 1) / 2)) printf("%s %s %d: ERROR: checksum\n", __FILE__, __FUNCTION__, __LINE__);
+	return nanoseconds / (valueCnt * producerCnt);
+}
+
+enum
+{
+	Single = 0,
+	Batch = 1,
+	Condvar = 2,
+	// SPSCQueue for the single producer single consumer runs, Single and Batch are SPSCBatchQueue there
+	SPSC = 3,
+	BatchCnt = 16
+};
+
+// nanoseconds per message through threadCnt producers and threadCnt consumers
+double runMPMC(int mode, unsigned threadCnt)
+{
+	MPMCQueue<uint64_t> mpmcQueue(Capacity);
+	CondvarQueue<uint64_t> condvarQueue(Capacity);
+	uint64_t valueCnt = MessageCnt / threadCnt;
+	std::atomic<bool> start(false);
+	std::atomic<uint64_t> sum(0);
+	std::vector<std::thread> threads;
+	for (unsigned producer = 0; producer < threadCnt; ++producer)
+	{
+		threads.emplace_back([&, valueCnt]
+		{
+			while (!start.load()) std::this_thread::yield();
+			uint64_t values[BatchCnt];
+			for (uint64_t idx = 0; idx < valueCnt;)
+			{
+				if (mode == Condvar) condvarQueue.push(idx++);
+				else if (mode == Single)
+				{
+					if (mpmcQueue.try_push(idx)) ++idx;
+					else std::this_thread::yield();
+				}
+				else
+				{
+					unsigned cnt = 0;
+					for (; cnt < BatchCnt && idx + cnt < valueCnt; ++cnt)
+						values[cnt] = idx + cnt;
+					unsigned pushed = mpmcQueue.try_push(values, cnt);
+					if (pushed) idx += pushed;
+					else std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for (unsigned consumer = 0; consumer < threadCnt; ++consumer)
+	{
+		threads.emplace_back([&, valueCnt]
+		{
+			while (!start.load()) std::this_thread::yield();
+			uint64_t values[BatchCnt], consumerSum(0);
+			// each consumer takes the same share, the producers write exactly that many in total
+			for (uint64_t cnt = 0; cnt < valueCnt;)
+			{
+				if (mode == Condvar)
+				{
+					condvarQueue.pop(values[0]);
+					consumerSum += values[0];
+					++cnt;
+				}
+				else
+				{
+					unsigned maxCnt = static_cast<unsigned>(std::min<uint64_t>(valueCnt - cnt, BatchCnt));
+					unsigned popped = mode == Single ? mpmcQueue.try_pop(values[0]) : mpmcQueue.try_pop(values, maxCnt);
+					if (!popped) std::this_thread::yield();
+					for (unsigned idx = 0; idx < popped; ++idx)
+						consumerSum += values[idx];
+					cnt += popped;
+				}
+			}
+			sum += consumerSum;
+		});
+	}
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	start = true;
+	for (std::thread &thread : threads)
+		thread.join();
+	double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+	if (sum != threadCnt * (valueCnt * (valueCnt - 1) / 2)) printf("%s %s %d: ERROR: checksum\n", __FILE__, __FUNCTION__, __LINE__);
+	return nanoseconds / (valueCnt * threadCnt);
+}
+// single element calls, SPSCQueue and SPSCBatchQueue share them
+template <typename Queue>
+void spscSingle(Queue &queue, uint64_t &sum)
+{
+	std::thread producer([&queue]
+	{
+		for (uint64_t idx = 0; idx < MessageCnt;)
+		{
+			uint64_t *back = queue.back();
+			if (!back)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			*back = idx++;
+			queue.push_back();
+		}
+	});
+	for (uint64_t cnt = 0; cnt < MessageCnt;)
+	{
+		uint64_t *front = queue.front();
+		if (!front)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		sum += *front;
+		queue.pop_front();
+		++cnt;
+	}
+	producer.join();
+}
+
+void spscBatch(SPSCBatchQueue<uint64_t> &queue, uint64_t &sum)
+{
+	std::thread producer([&queue]
+	{
+		for (uint64_t idx = 0; idx < MessageCnt;)
+		{
+			unsigned cnt = static_cast<unsigned>(std::min<uint64_t>(MessageCnt - idx, BatchCnt));
+			uint64_t *slots = queue.claim(cnt);
+			if (!slots)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			for (unsigned slot = 0; slot < cnt; ++slot)
+				slots[slot] = idx++;
+			queue.publish(cnt);
+		}
+	});
+	for (uint64_t cnt = 0; cnt < MessageCnt;)
+	{
+		unsigned peekCnt = BatchCnt;
+		uint64_t *slots = queue.peek(peekCnt);
+		if (!slots)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		for (unsigned slot = 0; slot < peekCnt; ++slot)
+			sum += slots[slot];
+		queue.release(peekCnt);
+		cnt += peekCnt;
+	}
+	producer.join();
+}
+
+// nanoseconds per message from one producer to one consumer
+double runSPSC(int mode)
+{
+	SPSCQueue<uint64_t> spscQueue(Capacity);
+	SPSCBatchQueue<uint64_t> batchQueue(Capacity);
+	uint64_t sum(0);
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	if (mode == SPSC) spscSingle(spscQueue, sum);
+	else if (mode == Single) spscSingle(batchQueue, sum);
+	else spscBatch(batchQueue, sum);
+	double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+	if (sum != static_cast<uint64_t>(MessageCnt) * (MessageCnt - 1) / 2) printf("%s %s %d: ERROR: checksum\n", __FILE__, __FUNCTION__, __LINE__);
+	return nanoseconds / MessageCnt;
+}
+
+// nanoseconds per round trip, a value goes out on one ring and comes back on the other
+template <typename Queue>
+double runPingPong()
+{
+	enum { RoundTripCnt = 100000 };
+	Queue ping(Capacity), pong(Capacity);
+	std::thread echo([&ping, &pong]
+	{
+		for (uint64_t cnt = 0; cnt < RoundTripCnt; ++cnt)
+		{
+			uint64_t *front, *back;
+			while (!(front = ping.front())) std::this_thread::yield();
+			while (!(back = pong.back())) std::this_thread::yield();
+			*back = *front;
+			ping.pop_front();
+			pong.push_back();
+		}
+	});
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	bool echoed(true);
+	for (uint64_t cnt = 0; cnt < RoundTripCnt; ++cnt)
+	{
+		uint64_t *slot;
+		while (!(slot = ping.back())) std::this_thread::yield();
+		*slot = cnt;
+		ping.push_back();
+		while (!(slot = pong.front())) std::this_thread::yield();
+		if (*slot != cnt) echoed = false;
+		pong.pop_front();
+	}
+	double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+	echo.join();
+	if (!echoed) printf("%s %s %d: ERROR: echo\n", __FILE__, __FUNCTION__, __LINE__);
+	return nanoseconds / RoundTripCnt;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+	std::vector<unsigned> producerCnts;
+	if (argc > 1) producerCnts.push_back(atoi(argv[1]));
+	else producerCnts = { 1, 2, 4, 8, 16, 32 };
+	printf("%-10s %18s %18s\n", "producers", "mpsc ns/msg", "mutex ns/msg");
+	for (unsigned producerCnt : producerCnts)
+	{
+		double mpsc(1e18), mutex(1e18);
+		for (int repetition = 0; repetition < Repetitions; ++repetition)
+		{
+			MPSCQueue<uint64_t> mpscQueue(Capacity);
+			MPSCReader mpscReader = { mpscQueue };
+			double nanoseconds = run(mpscQueue, mpscReader, producerCnt);
+			if (nanoseconds < mpsc) mpsc = nanoseconds;
+			MutexQueue<uint64_t> mutexQueue(Capacity);
+			nanoseconds = run(mutexQueue, mutexQueue, producerCnt);
+			if (nanoseconds < mutex) mutex = nanoseconds;
+		}
+		printf("%-10u %18.1f %18.1f\n", producerCnt, mpsc, mutex);
+	}
+
+	printf("\n%-10s %18s %18s %18s\n", "p = c", "mpmc ns/msg", "mpmc batch ns/msg", "condvar ns/msg");
+	for (unsigned threadCnt : producerCnts)
+	{
+		double best[3] = { 1e18, 1e18, 1e18 };
+		for (int repetition = 0; repetition < Repetitions; ++repetition)
+		{
+			for (int mode = Single; mode <= Condvar; ++mode)
+			{
+				double nanoseconds = runMPMC(mode, threadCnt);
+				if (nanoseconds < best[mode]) best[mode] = nanoseconds;
+			}
+		}
+		printf("%-10u %18.1f %18.1f %18.1f\n", threadCnt, best[Single], best[Batch], best[Condvar]);
+	}
+
+	double best[4] = { 1e18, 1e18, 1e18, 1e18 }, spscRoundTrip(1e18), batchRoundTrip(1e18);
+	for (int repetition = 0; repetition < Repetitions; ++repetition)
+	{
+		for (int mode : { SPSC, Single, Batch })
+			best[mode] = std::min(best[mode], runSPSC(mode));
+		spscRoundTrip = std::min(spscRoundTrip, runPingPong<SPSCQueue<uint64_t> >());
+		batchRoundTrip = std::min(batchRoundTrip, runPingPong<SPSCBatchQueue<uint64_t> >());
+	}
+	printf("\n%-22s %18s %18s\n", "1 producer 1 consumer", "ns/msg", "round trip ns");
+	printf("%-22s %18.1f %18.1f\n", "spsc", best[SPSC], spscRoundTrip);
+	printf("%-22s %18.1f %18.1f\n", "spsc batch, single", best[Single], batchRoundTrip);
+	printf("%-22s %18.1f %18s\n", "spsc batch, batch", best[Batch], "-");
+	return 0;
+}
@@ -0,0 +1,259 @@
+/*
+** QueueTest
+** - MPSCQueue under many producers on a small ring: every value arrives once and each producer's values in the order written
+** - values constructed in place are destroyed once, by pop or by the queue's destructor
+** - MPMCQueue with several producers and consumers, single and batch calls: every value is popped exactly once
+** - SPSCBatchQueue claim/publish and peek/release across the end of the ring: batches stop at the wrap and continue from the start,
+**   a producer and a consumer with different odd batch sizes see every value once and in order
+** - g++ -std=c++14 -O2 -I.. QueueTest.cpp -lpthread
+*/
+#include "MPMCQueue.h"
+#include "MPSCQueue.h"
+#include "SPSCBatchQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+enum
+{
+	Capacity = 64,
+	ValueCnt = 20000
+};
+
+int failures(0);
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+// producer in the top bits, its sequence number below
+void mpscFifo(unsigned producerCnt)
+{
+	MPSCQueue<uint64_t> queue(Capacity);
+	std::atomic<bool> start(false);
+	std::vector<std::thread> producers;
+	for (unsigned producer = 0; producer < producerCnt; ++producer)
+	{
+		producers.emplace_back([&queue, &start, producer]
+		{
+			while (!start.load()) std::this_thread::yield();
+			for (uint64_t idx = 0; idx < ValueCnt; ++idx)
+				while (!queue.write(static_cast<uint64_t>(producer) << 40 | idx)) std::this_thread::yield();
+		});
+	}
+	start = true;
+
+	std::vector<uint64_t> next(producerCnt, 0);
+	bool ordered(true);
+	for (uint64_t cnt = 0; cnt < static_cast<uint64_t>(producerCnt) * ValueCnt; ++cnt)
+	{
+		uint64_t value = *queue.front_wait();
+		queue.pop_front();
+		unsigned producer = static_cast<unsigned>(value >> 40);
+		if (producer >= producerCnt || (value & ((1ULL << 40) - 1)) != next[producer]++) ordered = false;
+	}
+	for (std::thread &thread : producers)
+		thread.join();
+	CHECK(ordered, "values out of producer order or from an unknown producer");
+	CHECK(!queue.front(), "values left after every producer's last one");
+}
+
+struct Counted
+{
+	static int _liveCnt;
+	int _value;
+	Counted(int value) : _value(value) { ++_liveCnt; }
+	Counted(const Counted &counted) : _value(counted._value) { ++_liveCnt; }
+	~Counted() { --_liveCnt; }
+};
+int Counted::_liveCnt(0);
+
+void mpscLifetime()
+{
+	{
+		MPSCQueue<Counted> queue(4);
+		for (int idx = 0; idx < 4; ++idx)
+			CHECK(queue.emplace(idx), "emplace into a queue with room");
+		CHECK(!queue.emplace(4), "emplace into a full queue");
+		int sum(0);
+		CHECK(queue.drain([&sum](Counted &counted) { sum += counted._value; }, 3) == 3 && sum == 3, "drain of three values");
+		CHECK(Counted::_liveCnt == 1, "drained values not destroyed");
+		CHECK(queue.emplace(5), "emplace after the drain");
+	}
+	CHECK(!Counted::_liveCnt, "values left in the queue not destroyed with it");
+}
+
+// values 0 to producerCnt * ValueCnt - 1, odd producers and consumers use the batch calls
+void mpmcExactlyOnce(unsigned producerCnt, unsigned consumerCnt)
+{
+	enum { BatchCnt = 8 };
+	MPMCQueue<uint32_t> queue(Capacity);
+	uint32_t valueCnt = producerCnt * ValueCnt;
+	std::unique_ptr<std::atomic<uint8_t>[]> seen(new std::atomic<uint8_t>[valueCnt]);
+	for (uint32_t value = 0; value < valueCnt; ++value)
+		seen[value].store(0, std::memory_order_relaxed);
+	std::atomic<uint32_t> poppedCnt(0);
+	std::atomic<bool> start(false);
+
+	std::vector<std::thread> threads;
+	for (unsigned producer = 0; producer < producerCnt; ++producer)
+	{
+		threads.emplace_back([&queue, &start, producer]
+		{
+			while (!start.load()) std::this_thread::yield();
+			uint32_t values[BatchCnt];
+			for (uint32_t idx = 0; idx < ValueCnt;)
+			{
+				if (producer & 1)
+				{
+					unsigned cnt = 0;
+					for (; cnt < BatchCnt && idx + cnt < ValueCnt; ++cnt)
+						values[cnt] = producer * ValueCnt + idx + cnt;
+					unsigned pushed = queue.try_push(values, cnt);
+					// a partial batch pushes the rest next time round
+					idx += pushed;
+					if (!pushed) std::this_thread::yield();
+				}
+				else if (queue.try_push(producer * ValueCnt + idx)) ++idx;
+				else std::this_thread::yield();
+			}
+		});
+	}
+	for (unsigned consumer = 0; consumer < consumerCnt; ++consumer)
+	{
+		threads.emplace_back([&queue, &start, &seen, &poppedCnt, valueCnt, consumer]
+		{
+			while (!start.load()) std::this_thread::yield();
+			uint32_t values[BatchCnt];
+			while (poppedCnt.load(std::memory_order_relaxed) < valueCnt)
+			{
+				unsigned cnt = consumer & 1 ? queue.try_pop(values, BatchCnt) : queue.try_pop(values[0]);
+				if (!cnt)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				for (unsigned idx = 0; idx < cnt; ++idx)
+					if (values[idx] < valueCnt) seen[values[idx]].fetch_add(1, std::memory_order_relaxed);
+				poppedCnt.fetch_add(cnt, std::memory_order_relaxed);
+			}
+		});
+	}
+	start = true;
+	for (std::thread &thread : threads)
+		thread.join();
+
+	bool once(true);
+	for (uint32_t value = 0; value < valueCnt; ++value)
+		if (seen[value].load(std::memory_order_relaxed) != 1) once = false;
+	CHECK(once, "values lost, duplicated or made up");
+	CHECK(poppedCnt.load() == valueCnt, "pop count");
+	uint32_t value;
+	CHECK(!queue.try_pop(value), "values left after every producer's last one");
+}
+void spscBatchWrap()
+{
+	SPSCBatchQueue<uint32_t> queue(8);
+	unsigned cnt = 5;
+	uint32_t *slots = queue.claim(cnt);
+	CHECK(slots && cnt == 5, "claim of 5 in an empty ring");
+	uint32_t *start = slots;
+	for (unsigned idx = 0; idx < cnt; ++idx)
+		slots[idx] = idx;
+	queue.publish(cnt);
+	cnt = 8;
+	CHECK(queue.peek(cnt) == start && cnt == 5, "peek sees the published values only");
+	queue.release(cnt);
+	cnt = 8;
+	CHECK(!queue.peek(cnt) && !cnt, "peek of an empty ring");
+
+	// 8 free slots, 3 before the end of the buffer and 5 after the wrap
+	cnt = 7;
+	slots = queue.claim(cnt);
+	CHECK(slots == start + 5 && cnt == 3, "claim stops at the end of the buffer");
+	for (unsigned idx = 0; idx < cnt; ++idx)
+		slots[idx] = 5 + idx;
+	queue.publish(cnt);
+	cnt = 7;
+	slots = queue.claim(cnt);
+	CHECK(slots == start && cnt == 5, "claim continues at the start of the buffer");
+	for (unsigned idx = 0; idx < cnt; ++idx)
+		slots[idx] = 8 + idx;
+	queue.publish(cnt);
+	cnt = 1;
+	CHECK(!queue.claim(cnt) && !cnt, "claim of a full ring");
+
+	cnt = 8;
+	slots = queue.peek(cnt);
+	CHECK(slots == start + 5 && cnt == 3 && slots[0] == 5 && slots[2] == 7, "peek stops at the end of the buffer");
+	queue.release(2);
+	cnt = 8;
+	slots = queue.peek(cnt);
+	CHECK(slots == start + 7 && cnt == 1 && *slots == 7, "peek after a partial release");
+	queue.release(cnt);
+	cnt = 8;
+	slots = queue.peek(cnt);
+	CHECK(slots == start && cnt == 5 && slots[0] == 8 && slots[4] == 12, "peek continues at the start of the buffer");
+	queue.release(cnt);
+
+	// odd batch sizes on a small ring wrap at every position
+	enum { WrapCnt = 200000 };
+	SPSCBatchQueue<uint32_t> ring(16);
+	std::thread producer([&ring]
+	{
+		uint32_t value = 0;
+		for (unsigned batch = 0; value < WrapCnt; ++batch)
+		{
+			unsigned claimCnt = std::min<unsigned>(1 + batch % 7, WrapCnt - value);
+			uint32_t *claimed = ring.claim(claimCnt);
+			if (!claimed)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			for (unsigned idx = 0; idx < claimCnt; ++idx)
+				claimed[idx] = value++;
+			ring.publish(claimCnt);
+		}
+	});
+	uint32_t next = 0;
+	bool ordered(true);
+	for (unsigned batch = 0; next < WrapCnt;)
+	{
+		cnt = 1 + batch % 5;
+		slots = ring.peek(cnt);
+		if (!slots)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		++batch;
+		for (unsigned idx = 0; idx < cnt; ++idx)
+			if (slots[idx] != next++) ordered = false;
+		ring.release(cnt);
+	}
+	producer.join();
+	CHECK(ordered, "values out of order across the wrap");
+	cnt = 1;
+	CHECK(!ring.peek(cnt), "values left after the producer's last one");
+}
+} // namespace
+
+int main()
+{
+	for (unsigned producerCnt : { 8, 16, 32 })
+		mpscFifo(producerCnt);
+	mpscLifetime();
+	mpmcExactlyOnce(4, 4);
+	mpmcExactlyOnce(8, 2);
+	mpmcExactlyOnce(2, 8);
+	spscBatchWrap();
+
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+/*
+** QuoteTest
+** - market orders of the order feed that take a quote order completely leave it out of the book,
+**   the next quotes replace it without a price level to replace it in
+** - a market order of the order feed crossing a larger simulated order fills it partially
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -I.. QuoteTest.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp
+*/
+#include "ExchangeSimulator.h"
+#include "FixMsgType.h"
+#include "FixOrdStatus.h"
+#include "Order.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+class TestExchange : public ExchangeSimulator
+{
+public:
+	TestExchange(TimeManager *timeManager, SymbolRegistry *symbolRegistry) : ExchangeSimulator(0, 4, 64, timeManager, symbolRegistry) {}
+	const OrderBook *book(SymbolId symbolId) const { return findOrderBook(symbolId); }
+};
+
+class TestOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	TestOrder(SymbolId symbolId, char side, uint64_t clOrdId, unsigned orderQty, unsigned price, const timespec &ts)
+	{
+		memset(&_common, 0, sizeof(_common));
+		_chainCommon = &_common;
+		newOrder(symbolId, side, orderQty, price, ts);
+		_msgType = FIX::MsgType::NewOrder;
+		_clOrdId = clOrdId;
+	}
+};
+
+class Fills : public ExecutionReportCallback
+{
+public:
+	std::vector<SimulatorExecutionReport> _fills;
+	void onExecution(SimulatorExecutionReport &executionReport)
+	{
+		if (executionReport._lastQty) _fills.push_back(executionReport);
+	}
+};
+
+int failures(0);
+} // namespace
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+int main()
+{
+	SymbolRegistry symbolRegistry;
+	SymbolId symbolId = symbolRegistry.intern("MSFT");
+	TimeManager timeManager;
+	TestExchange exchange(&timeManager, &symbolRegistry);
+
+	Quote quote;
+	memset(&quote, 0, sizeof(quote));
+	quote._type = Tick::Quote;
+	quote._symbolId = symbolId;
+	quote._price[0] = 100;
+	quote._price[1] = 102;
+	quote._size[0] = quote._size[1] = 50;
+	timespec ts = { 1000, 0 };
+	quote._ts = ts;
+	exchange.onTick(quote);
+
+	// a market buy through the ask and a market sell through the bid take both quote orders
+	MarketOrder marketOrder;
+	memset(&marketOrder, 0, sizeof(marketOrder));
+	marketOrder._type = Tick::MarketOrder;
+	marketOrder._symbolId = symbolId;
+	marketOrder._action = MarketOrder::Add;
+	marketOrder._size = 10;
+	for (int side = 0; side < 2; ++side)
+	{
+		marketOrder._orderId = side + 1;
+		marketOrder._side = side;
+		marketOrder._price = side ? 100 : 102;
+		ts.tv_nsec += 10;
+		marketOrder._ts = ts;
+		exchange.onTick(marketOrder);
+	}
+
+	// new quotes on both sides of the old ones
+	unsigned prices[][2] = { { 99, 103 }, { 103, 104 }, { 101, 102 } };
+	for (unsigned idx = 0; idx < sizeof(prices) / sizeof(*prices); ++idx)
+	{
+		ts.tv_nsec += 10;
+		quote._ts = ts;
+		quote._price[0] = prices[idx][0];
+		quote._price[1] = prices[idx][1];
+		exchange.onTick(quote);
+	}
+	CHECK(exchange.book(symbolId)->ask() == 102, "quote not replaced");
+
+	// without quotes a simulated sell rests inside a market order sell, a smaller market order buy takes part of it
+	Fills fills;
+	exchange.setExecutionReportCallback(&fills);
+	SymbolId feedSymbolId = symbolRegistry.intern("AAPL");
+	marketOrder._symbolId = feedSymbolId;
+	marketOrder._orderId = 10;
+	marketOrder._side = 1;
+	marketOrder._price = 110;
+	ts.tv_nsec += 10;
+	marketOrder._ts = ts;
+	exchange.onTick(marketOrder);
+	TestOrder order(feedSymbolId, '2', 1, 10000, 105, ts);
+	exchange.onOrder(&order);
+	marketOrder._orderId = 11;
+	marketOrder._side = 0;
+	marketOrder._price = 105;
+	marketOrder._size = 100;
+	ts.tv_nsec += 10;
+	marketOrder._ts = ts;
+	exchange.onTick(marketOrder);
+	CHECK(fills._fills.size() == 1, "market order did not fill the simulated order once");
+	CHECK(!fills._fills.empty() && fills._fills[0]._lastQty == 100 && fills._fills[0]._lastPx == 105, "fill is not the market order size");
+	CHECK(!fills._fills.empty() && fills._fills[0]._ordStatus == FIX::OrdStatus::PartiallyFilled, "simulated order not partially filled");
+	CHECK(exchange.book(feedSymbolId)->ask() == 105 && exchange.book(feedSymbolId)->bid() == 0, "simulated order gone or market order left in the book");
+
+	// the next buy takes more of it, the rest stays
+	marketOrder._orderId = 12;
+	marketOrder._size = 400;
+	ts.tv_nsec += 10;
+	marketOrder._ts = ts;
+	exchange.onTick(marketOrder);
+	CHECK(fills._fills.size() == 2 && fills._fills[1]._lastQty == 400, "second market order fill is not its size");
+	exchange.setExecutionReportCallback(0);
+
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*
+** RejectBenchmark
+** - reject storms through timeEvent: new orders reusing one clOrdId and cancels of an order the simulator never saw,
+**   each batch of orders arrives with one time step
+** - reports either go unread or the consumer reads text(), which formats the reject on demand
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -O2 -I.. RejectBenchmark.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp
+** - usage: RejectBenchmark [orders]
+*/
+#include "ExchangeSimulator.h"
+#include "FixExecType.h"
+#include "FixMsgType.h"
+#include "Order.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+class BenchmarkOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	BenchmarkOrder() { memset(&_common, 0, sizeof(_common)); _chainCommon = &_common; }
+	void set(SymbolId symbolId, unsigned msgType, uint64_t clOrdId, Order *original, const timespec &ts)
+	{
+		newOrder(symbolId, '1', 100, 90, ts);
+		_msgType = msgType;
+		_clOrdId = clOrdId;
+		_original = original;
+	}
+};
+
+struct RejectCallback : public ExecutionReportCallback
+{
+	bool _readText;
+	size_t _rejectCnt;
+	size_t _textBytes;
+	RejectCallback(bool readText) : _readText(readText), _rejectCnt(0), _textBytes(0) {}
+	void onExecution(SimulatorExecutionReport &executionReport)
+	{
+		if (executionReport._execType != FIX::ExecType::Rejected) return;
+		++_rejectCnt;
+		if (_readText) _textBytes += strlen(executionReport.text());
+	}
+};
+
+enum
+{
+	BatchSize = 1000,
+	Repetitions = 5
+};
+
+// best of the repetitions in nanoseconds per order
+double run(unsigned msgType, bool readText, size_t orderCnt, size_t &rejectCnt)
+{
+	double best = 1e18;
+	for (int repetition = 0; repetition < Repetitions; ++repetition)
+	{
+		SymbolRegistry symbolRegistry;
+		SymbolId symbolId = symbolRegistry.intern("X");
+		TimeManager timeManager;
+		ExchangeSimulator exchange(0, 16, 1 << 16, &timeManager, &symbolRegistry);
+		RejectCallback callback(readText);
+		exchange.setExecutionReportCallback(&callback);
+
+		Quote quote;
+		memset(&quote, 0, sizeof(quote));
+		quote._type = Tick::Quote;
+		quote._symbolId = symbolId;
+		quote._price[0] = 99;
+		quote._price[1] = 101;
+		quote._size[0] = quote._size[1] = 100;
+		timespec ts = { 1000, 0 };
+		quote._ts = ts;
+		exchange.onTick(quote);
+
+		// duplicates all reuse clOrdId 1, cancels all refer to an order that never reached the simulator
+		BenchmarkOrder unknown;
+		unknown.set(symbolId, FIX::MsgType::NewOrder, 999999999, 0, ts);
+		std::vector<BenchmarkOrder> orders(orderCnt);
+		for (size_t idx = 0; idx < orderCnt; ++idx)
+		{
+			if (msgType == FIX::MsgType::NewOrder) orders[idx].set(symbolId, msgType, 1, 0, ts);
+			else orders[idx].set(symbolId, msgType, idx + 1, &unknown, ts);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (size_t idx = 0; idx < orderCnt; idx += BatchSize)
+		{
+			for (size_t order = idx; order < std::min<size_t>(idx + BatchSize, orderCnt); ++order)
+				exchange.onOrder(&orders[order]);
+			++ts.tv_nsec;
+			timeManager.setTime(ts);
+		}
+		best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / orderCnt);
+		rejectCnt = callback._rejectCnt;
+	}
+	return best;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+	size_t orderCnt = argc > 1 ? atoi(argv[1]) : 1000000;
+	printf("%24s %12s %16s %16s\n", "workload", "rejects", "unread ns", "text() ns");
+	struct { const char *name; unsigned msgType; } workloads[] = { { "duplicate clOrdId", FIX::MsgType::NewOrder }, { "unknown origClOrdId", FIX::MsgType::CancelRequest } };
+	for (auto &workload : workloads)
+	{
+		size_t rejectCnt, textRejectCnt;
+		double unread = run(workload.msgType, false, orderCnt, rejectCnt);
+		double text = run(workload.msgType, true, orderCnt, textRejectCnt);
+		printf("%24s %12zu %16.1f %16.1f\n", workload.name, rejectCnt, unread, text);
+	}
+	return 0;
+}
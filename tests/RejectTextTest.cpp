@@ -0,0 +1,101 @@
+/*
+** RejectTextTest
+** - text() of reject reports reads as the text the reject paths formatted before rejects became reason codes,
+**   the old paths cut the text at a 32 byte buffer, the ids here fit it
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -I.. RejectTextTest.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp
+*/
+#include "ExchangeSimulator.h"
+#include "FixExecType.h"
+#include "FixMsgType.h"
+#include "Order.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+class TestOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	TestOrder(SymbolId symbolId, unsigned msgType, uint64_t clOrdId, Order *original, const timespec &ts)
+	{
+		memset(&_common, 0, sizeof(_common));
+		_chainCommon = &_common;
+		newOrder(symbolId, '1', 100, 90, ts);
+		_msgType = msgType;
+		_clOrdId = clOrdId;
+		_original = original;
+	}
+};
+
+class RejectText : public ExecutionReportCallback
+{
+public:
+	std::vector<std::string> _texts;
+	void onExecution(SimulatorExecutionReport &executionReport)
+	{
+		if (executionReport._execType == FIX::ExecType::Rejected) _texts.push_back(executionReport.text());
+	}
+};
+
+int failures(0);
+} // namespace
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+int main()
+{
+	SymbolRegistry symbolRegistry;
+	SymbolId symbolId = symbolRegistry.intern("MSFT");
+	TimeManager timeManager;
+	ExchangeSimulator exchange(0, 4, 64, &timeManager, &symbolRegistry);
+	RejectText rejectText;
+	exchange.setExecutionReportCallback(&rejectText);
+
+	timespec ts = { 1000, 0 };
+	uint64_t ids[] = { 1, 42, 1234567, 99999999999ULL };
+	std::vector<TestOrder*> orders;
+	std::vector<std::string> expected;
+	char text[32];
+	for (uint64_t id : ids)
+	{
+		// the first order takes the id, the second one is a duplicate
+		orders.push_back(new TestOrder(symbolId, FIX::MsgType::NewOrder, id, 0, ts));
+		orders.push_back(new TestOrder(symbolId, FIX::MsgType::NewOrder, id, 0, ts));
+		snprintf(text, sizeof(text), "clOrdId %llu: not unique", static_cast<unsigned long long>(id));
+		expected.push_back(text);
+	}
+	// a cancel and a replace of an order that never reached the simulator
+	TestOrder unknown(symbolId, FIX::MsgType::NewOrder, 7654321, 0, ts);
+	orders.push_back(new TestOrder(symbolId, FIX::MsgType::CancelRequest, 11, &unknown, ts));
+	orders.push_back(new TestOrder(symbolId, FIX::MsgType::ReplaceRequest, 12, &unknown, ts));
+	snprintf(text, sizeof(text), "origClOrdId %llu unknown", static_cast<unsigned long long>(unknown.clOrdId()));
+	expected.push_back(text);
+	expected.push_back(text);
+	orders.push_back(new TestOrder(symbolId, 'Z', 13, 0, ts));
+	expected.push_back("unhandled MsgType");
+
+	for (TestOrder *order : orders)
+		exchange.onOrder(order);
+	ts.tv_nsec = 1000;
+	timeManager.setTime(ts);
+
+	CHECK(rejectText._texts.size() == expected.size(), "wrong reject count");
+	for (size_t idx = 0; idx < expected.size() && idx < rejectText._texts.size(); ++idx)
+	{
+		if (rejectText._texts[idx] == expected[idx]) continue;
+		printf("'%s' is not '%s'\n", rejectText._texts[idx].c_str(), expected[idx].c_str());
+		CHECK(false, "text differs from the old reject text");
+	}
+
+	for (TestOrder *order : orders)
+		delete order;
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
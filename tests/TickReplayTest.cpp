@@ -0,0 +1,135 @@
+/*
+** TickReplayTest
+** - the same ticks through onTick one at a time and through onTicks give the same execution reports,
+**   including a timer another component adds to the shared TimeManager for the current timestamp from a report callback
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -I.. TickReplayTest.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp
+*/
+#include "ExchangeSimulator.h"
+#include "FixMsgType.h"
+#include "Order.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+class TestOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	TestOrder(SymbolId symbolId, char side, uint64_t clOrdId, unsigned orderQty, unsigned price, const timespec &ts)
+	{
+		memset(&_common, 0, sizeof(_common));
+		_chainCommon = &_common;
+		newOrder(symbolId, side, orderQty, price, ts);
+		_msgType = FIX::MsgType::NewOrder;
+		_clOrdId = clOrdId;
+	}
+};
+
+// logs the reports, the first fill arms a timer at the fill time that logs when it runs
+class ReportLog : public ExecutionReportCallback, public TimeEventObject
+{
+protected:
+	TimeManager &_timeManager;
+	bool _armed;
+public:
+	std::string _log;
+	ReportLog(TimeManager &timeManager) : _timeManager(timeManager), _armed(false) {}
+	void onExecution(SimulatorExecutionReport &executionReport)
+	{
+		char line[128];
+		snprintf(line, sizeof(line), "%llu %c %u %u %llu\n", static_cast<unsigned long long>(executionReport._clOrdId), executionReport._execType,
+			executionReport._lastPx, executionReport._lastQty, static_cast<unsigned long long>(executionReport._transactTime));
+		_log += line;
+		if (executionReport._lastQty && !_armed)
+		{
+			_armed = true;
+			_timespec = _timeManager.time();
+			_timeManager.addCallback(this);
+		}
+	}
+	void timeEvent(const timespec &ts)
+	{
+		char line[64];
+		snprintf(line, sizeof(line), "timer %lld.%09ld\n", static_cast<long long>(ts.tv_sec), ts.tv_nsec);
+		_log += line;
+	}
+};
+
+struct Replay
+{
+	TimeManager _timeManager;
+	ReportLog _reportLog;
+	ExchangeSimulator _exchange;
+	std::vector<TestOrder*> _orders;
+	Replay(SymbolRegistry &symbolRegistry) : _reportLog(_timeManager), _exchange(0, 4, 64, &_timeManager, &symbolRegistry)
+	{
+		_exchange.setExecutionReportCallback(&_reportLog);
+	}
+	~Replay()
+	{
+		for (TestOrder *order : _orders)
+			delete order;
+	}
+	void order(SymbolId symbolId, uint64_t clOrdId, unsigned price, const timespec &ts)
+	{
+		_orders.push_back(new TestOrder(symbolId, '1', clOrdId, 100, price, ts));
+		_exchange.onOrder(_orders.back());
+	}
+};
+
+int failures(0);
+} // namespace
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+int main()
+{
+	SymbolRegistry symbolRegistry;
+	SymbolId symbolId = symbolRegistry.intern("MSFT");
+
+	// quotes lowering the ask through two resting bids, three ticks share the second timestamp
+	std::vector<Quote> quotes;
+	unsigned prices[][3] = { { 0, 1000, 1010 }, { 1, 1000, 1010 }, { 2, 1000, 1008 }, { 2, 1000, 1006 }, { 2, 1000, 1007 }, { 3, 1000, 1010 } };
+	for (unsigned idx = 0; idx < sizeof(prices) / sizeof(*prices); ++idx)
+	{
+		Quote quote;
+		memset(&quote, 0, sizeof(quote));
+		quote._type = Tick::Quote;
+		quote._symbolId = symbolId;
+		quote._ts.tv_sec = 1000;
+		quote._ts.tv_nsec = prices[idx][0] * 1000;
+		quote._price[0] = prices[idx][1];
+		quote._price[1] = prices[idx][2];
+		quote._size[0] = quote._size[1] = 500;
+		quotes.push_back(quote);
+	}
+	std::vector<const Tick*> ticks;
+	for (const Quote &quote : quotes)
+		ticks.push_back(&quote);
+
+	Replay single(symbolRegistry), batch(symbolRegistry);
+	for (Replay *replay : { &single, &batch })
+	{
+		replay->_exchange.onTick(*ticks[0]);
+		replay->order(symbolId, 1, 1008, ticks[0]->_ts);
+		replay->order(symbolId, 2, 1006, ticks[0]->_ts);
+	}
+	for (size_t idx = 1; idx < ticks.size(); ++idx)
+		single._exchange.onTick(*ticks[idx]);
+	batch._exchange.onTicks(&ticks[1], ticks.size() - 1);
+
+	CHECK(single._reportLog._log.find("timer") != std::string::npos, "report callback timer never ran");
+	CHECK(single._reportLog._log.find("timer") < single._reportLog._log.find("2 F"), "timer ran after the next tick at its timestamp");
+	CHECK(single._reportLog._log == batch._reportLog._log, "onTicks reports differ from onTick");
+	if (single._reportLog._log != batch._reportLog._log) printf("onTick\n%sonTicks\n%s", single._reportLog._log.c_str(), batch._reportLog._log.c_str());
+
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
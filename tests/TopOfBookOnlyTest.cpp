@@ -0,0 +1,131 @@
+/*
+** TopOfBookOnlyTest
+** - a depth consumer of a lazy top of book book sees the quote levels removed once on demotion,
+**   nothing while the book is top of book only and the levels added again on promotion
+** - builds in the full trading tree only: ExecutionReport.h and the Fix*.h headers are not in this snapshot
+**   and the snapshot's Intrusive headers do not compile with g++, there:
+**   g++ -std=c++14 -I.. TopOfBookOnlyTest.cpp ../ExchangeSimulator.cpp ../OrderBook.cpp ../SymbolRegistry.cpp ../SimulatorStats.cpp
+*/
+#include "ExchangeSimulator.h"
+#include "FixMsgType.h"
+#include "Order.h"
+
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+
+namespace
+{
+class TestOrder : public Order
+{
+protected:
+	ChainCommon _common;
+public:
+	TestOrder(SymbolId symbolId, char side, uint64_t clOrdId, unsigned orderQty, unsigned price, const timespec &ts)
+	{
+		memset(&_common, 0, sizeof(_common));
+		_chainCommon = &_common;
+		newOrder(symbolId, side, orderQty, price, ts);
+		_msgType = FIX::MsgType::NewOrder;
+		_clOrdId = clOrdId;
+	}
+};
+
+struct NullCallback : public ExecutionReportCallback
+{
+	void onExecution(SimulatorExecutionReport&) {}
+};
+
+class TestExchange : public ExchangeSimulator
+{
+public:
+	TestExchange(TimeManager *timeManager, SymbolRegistry *symbolRegistry) : ExchangeSimulator(0, 16, 1024, timeManager, symbolRegistry) {}
+	bool topOfBookOnly(SymbolId symbolId) const { return findOrderBook(symbolId)->topOfBookOnly(); }
+};
+
+// the consumer's copy of the book, side and price to shares
+struct DepthBook : public DepthCallback
+{
+	std::map<std::pair<int, unsigned>, unsigned> _levels;
+	size_t _updateCnt;
+	DepthBook() : _updateCnt(0) {}
+	void onDepth(const OrderBook&, const DepthDelta *depthDeltas, size_t depthDeltaCnt, bool)
+	{
+		++_updateCnt;
+		for (size_t idx = 0; idx < depthDeltaCnt; ++idx)
+		{
+			const DepthDelta &depthDelta = depthDeltas[idx];
+			std::pair<int, unsigned> key(depthDelta._side, depthDelta._price);
+			if (depthDelta._shares) _levels[key] = depthDelta._shares;
+			else _levels.erase(key);
+		}
+	}
+	bool has(int side, unsigned price) const { return _levels.count(std::make_pair(side, price)) != 0; }
+};
+
+int failures(0);
+} // namespace
+
+#define CHECK(ok, what) if (!(ok)) { printf("%s %s %d: %s\n", __FILE__, __FUNCTION__, __LINE__, what); ++failures; }
+
+int main()
+{
+	SymbolRegistry symbolRegistry;
+	SymbolId symbolId = symbolRegistry.intern("MSFT");
+	TimeManager timeManager;
+	TestExchange exchange(&timeManager, &symbolRegistry);
+	NullCallback callback;
+	DepthBook depthBook;
+	exchange.setExecutionReportCallback(&callback);
+	exchange.setDepthCallback(&depthBook);
+	exchange.setLazyTopOfBook(true);
+
+	Quote quote;
+	memset(&quote, 0, sizeof(quote));
+	quote._type = Tick::Quote;
+	quote._symbolId = symbolId;
+	quote._size[0] = quote._size[1] = 500;
+	timespec ts = { 1000, 0 };
+	auto onQuote = [&](unsigned bid, unsigned ask)
+	{
+		ts.tv_nsec += 1000;
+		quote._ts = ts;
+		quote._price[0] = bid;
+		quote._price[1] = ask;
+		exchange.onTick(quote);
+	};
+
+	onQuote(100, 102);
+	CHECK(exchange.topOfBookOnly(symbolId), "book without simulated orders is not top of book only");
+	CHECK(!depthBook._updateCnt, "top of book only book published depth");
+
+	// a simulated bid inside the spread promotes the book
+	TestOrder bid(symbolId, '1', 1, 100, 101, ts);
+	exchange.onOrder(&bid);
+	onQuote(100, 102);
+	CHECK(!exchange.topOfBookOnly(symbolId), "order did not promote the book");
+	CHECK(depthBook.has(0, 100) && depthBook.has(0, 101) && depthBook.has(1, 102), "promotion did not add the levels");
+
+	// the ask through the bid fills it and the book is demoted, the consumer's copy goes empty
+	size_t updateCnt = depthBook._updateCnt;
+	onQuote(100, 101);
+	CHECK(exchange.topOfBookOnly(symbolId), "book not demoted after its last simulated order filled");
+	CHECK(depthBook._updateCnt == updateCnt + 1, "demotion is not one depth update");
+	CHECK(depthBook._levels.empty(), "demotion left levels behind");
+
+	// quotes of a top of book only book publish nothing
+	updateCnt = depthBook._updateCnt;
+	onQuote(99, 103);
+	onQuote(98, 103);
+	CHECK(depthBook._updateCnt == updateCnt, "top of book only quotes published depth");
+
+	// the next order brings back the quote levels at the last quote
+	TestOrder ask(symbolId, '2', 2, 100, 105, ts);
+	exchange.onOrder(&ask);
+	onQuote(98, 103);
+	CHECK(depthBook.has(0, 98) && depthBook.has(1, 103) && depthBook.has(1, 105) && depthBook._levels.size() == 3, "second promotion levels");
+
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}